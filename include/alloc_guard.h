@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+// Debug aid for keeping the hot paths off the heap, only active when built
+// with TDFREE_ALLOC_GUARD (env:mini_c3_alloc_guard), which also wraps
+// malloc, calloc and realloc at link time.
+//
+// Once armed at the end of setup() every allocation is counted. One made
+// while a NoAllocScope is open in the same task aborts with a backtrace.
+// Allocations of the WiFi, lwIP and AsyncTCP internals are counted only,
+// those libraries allocate per packet and connection by design.
+#ifdef TDFREE_ALLOC_GUARD
+
+void armAllocGuard();
+
+// Allocations since armAllocGuard()
+uint32_t allocationsAfterSetup();
+
+class NoAllocScope
+{
+public:
+  NoAllocScope();
+  ~NoAllocScope();
+};
+
+#else
+
+inline void armAllocGuard() {}
+
+inline uint32_t allocationsAfterSetup()
+{
+  return 0;
+}
+
+class NoAllocScope
+{
+public:
+  NoAllocScope() {}
+};
+
+#endif
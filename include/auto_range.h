@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// One gain/integration time combination of the VEML7700.
+// gain and integration_time are the raw register codes, the same values as
+// the VEML7700_GAIN_* and VEML7700_IT_* constants of the Adafruit library.
+struct RangeSetting
+{
+  uint8_t gain;
+  uint8_t integration_time;
+  float gain_value;
+  uint16_t integration_ms;
+};
+
+// Picks the sensor range for the next reading from the raw count of the last one.
+//
+// Settings are ordered from least to most sensitive. Gain is raised first while
+// the integration time stays at 25 ms, the integration time only gets longer once
+// the gain is maxed out, so bright readings (the baseline, translucent filament)
+// are fast and only weak signals pay for long integration.
+class AutoRange
+{
+public:
+  enum Step
+  {
+    KEEP,    // reading is fine, stay on this setting
+    CHANGED, // reading is usable, but the next one should use the new setting
+    RETRY,   // reading was saturated, take it again with the new setting
+  };
+
+  // Counts above this are treated as saturated
+  static const uint16_t SATURATED_COUNT = 60000;
+  // Step down before getting close to saturation
+  static const uint16_t HIGH_COUNT = 40000;
+  // Step up below this, resolution gets poor with few counts
+  static const uint16_t LOW_COUNT = 2000;
+
+  // Lux per count at gain 2 and 800 ms, as used by the Adafruit library
+  static constexpr float MAX_RESOLUTION = 0.0036f;
+
+  static const size_t SETTING_COUNT = 9;
+
+  AutoRange() : index(0) {}
+
+  static const RangeSetting &setting(size_t i)
+  {
+    static const RangeSetting settings[SETTING_COUNT] = {
+        {0x02, 0x0C, 0.125f, 25},
+        {0x03, 0x0C, 0.25f, 25},
+        {0x00, 0x0C, 1.0f, 25},
+        {0x01, 0x0C, 2.0f, 25},
+        {0x01, 0x08, 2.0f, 50},
+        {0x01, 0x00, 2.0f, 100},
+        {0x01, 0x01, 2.0f, 200},
+        {0x01, 0x02, 2.0f, 400},
+        {0x01, 0x03, 2.0f, 800},
+    };
+    return settings[i];
+  }
+
+  const RangeSetting &current() const
+  {
+    return setting(index);
+  }
+
+  size_t currentIndex() const
+  {
+    return index;
+  }
+
+  void select(size_t i)
+  {
+    index = i < SETTING_COUNT ? i : SETTING_COUNT - 1;
+  }
+
+  // Lux for a raw ALS count taken with the current setting
+  float lux(uint16_t count) const
+  {
+    return count * resolution(current());
+  }
+
+  // Call with the count of every reading, after converting it with lux()
+  Step update(uint16_t count)
+  {
+    if (count >= SATURATED_COUNT && index > 0)
+    {
+      index--;
+      return RETRY;
+    }
+    if (count > HIGH_COUNT && index > 0)
+    {
+      index--;
+      return CHANGED;
+    }
+    if (count < LOW_COUNT && index + 1 < SETTING_COUNT)
+    {
+      // Only step up if the same light won't land above HIGH_COUNT, otherwise we'd oscillate
+      float ratio = sensitivity(setting(index + 1)) / sensitivity(current());
+      if (count * ratio < HIGH_COUNT)
+      {
+        index++;
+        return CHANGED;
+      }
+    }
+    return KEEP;
+  }
+
+  // Lux per count of a setting
+  static float resolution(const RangeSetting &s)
+  {
+    return MAX_RESOLUTION * (2.0f * 800.0f) / sensitivity(s);
+  }
+
+private:
+  static float sensitivity(const RangeSetting &s)
+  {
+    return s.gain_value * s.integration_ms;
+  }
+
+  size_t index;
+};
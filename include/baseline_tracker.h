@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+// Follows slow drift of the empty-tube reading (LED warm-up, ambient light)
+// with a slow EMA, fed only while no filament is inserted.
+class BaselineTracker
+{
+public:
+  // weight:   EMA factor per accepted reading
+  // max_step: readings further than this fraction from the baseline are ignored
+  // holdoff:  empty readings to skip after a removal, the light path needs a moment
+  BaselineTracker(float weight, float max_step, uint16_t holdoff)
+      : weight(weight), max_step(max_step), holdoff(holdoff), skip(holdoff) {}
+
+  // Feeds one reading of the empty tube, returns the updated baseline
+  float update(float baseline, float lux)
+  {
+    if (skip > 0)
+    {
+      skip--;
+      return baseline;
+    }
+    float step = lux - baseline;
+    float limit = baseline * max_step;
+    if (baseline <= 0 || step > limit || step < -limit)
+    {
+      return baseline;
+    }
+    return baseline + weight * step;
+  }
+
+  // Call for every reading with filament in, restarts the holdoff
+  void hold()
+  {
+    skip = holdoff;
+  }
+
+private:
+  float weight;
+  float max_step;
+  uint16_t holdoff;
+  uint16_t skip;
+};
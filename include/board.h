@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+// Everything that differs between the supported boards, picked at compile
+// time from the ARDUINO_<board> macro PlatformIO defines for the env's board.
+// Code branches on these constants, the compiler drops the arms a board can't take.
+
+// Lolin C3 Mini: single core RISC-V, Serial is the native USB CDC port
+struct LolinC3Mini
+{
+  static constexpr uint8_t I2C_SDA = 8;
+  static constexpr uint8_t I2C_SCL = 10;
+  static constexpr uint8_t CORES = 1;
+  static constexpr bool USB_CDC = true;
+};
+
+// Wemos D1 Mini ESP32: dual core, Serial goes through a USB-UART bridge
+struct WemosD1Mini32
+{
+  static constexpr uint8_t I2C_SDA = 21;
+  static constexpr uint8_t I2C_SCL = 22;
+  static constexpr uint8_t CORES = 2;
+  static constexpr bool USB_CDC = false;
+};
+
+// env:native, for the host benchmarks in test/
+struct NativeHost
+{
+  static constexpr uint8_t I2C_SDA = 0;
+  static constexpr uint8_t I2C_SCL = 0;
+  static constexpr uint8_t CORES = 1;
+  static constexpr bool USB_CDC = false;
+};
+
+#if defined(ARDUINO_LOLIN_C3_MINI)
+typedef LolinC3Mini Board;
+#elif defined(ARDUINO_D1_MINI32)
+typedef WemosD1Mini32 Board;
+#elif defined(TDFREE_NATIVE)
+typedef NativeHost Board;
+#else
+#error "Unsupported board, add it to board.h"
+#endif
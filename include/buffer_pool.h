@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Count fixed-size buffers handed out per request and returned when it ends.
+// Set aside once at startup, so serving requests never touches the heap and
+// can't fragment it. acquire() and release() are lock-free and can be called
+// from any task.
+template <size_t Size, size_t Count>
+class BufferPool
+{
+public:
+  BufferPool()
+  {
+    for (size_t i = 0; i < Count; i++)
+    {
+      used[i].store(false, std::memory_order_relaxed);
+    }
+  }
+
+  // NULL when every buffer is taken, the caller should answer 503 then
+  uint8_t *acquire()
+  {
+    for (size_t i = 0; i < Count; i++)
+    {
+      bool expected = false;
+      if (used[i].compare_exchange_strong(expected, true, std::memory_order_acquire))
+      {
+        return buffers[i];
+      }
+    }
+    return NULL;
+  }
+
+  void release(uint8_t *buffer)
+  {
+    for (size_t i = 0; i < Count; i++)
+    {
+      if (buffers[i] == buffer)
+      {
+        used[i].store(false, std::memory_order_release);
+        return;
+      }
+    }
+  }
+
+  static constexpr size_t size()
+  {
+    return Size;
+  }
+
+private:
+  std::atomic<bool> used[Count];
+  alignas(4) uint8_t buffers[Count][Size];
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <Arduino.h>
+#include <AsyncUDP.h>
+#include <atomic>
+
+// Answers every A query with one address, which is all a captive portal needs.
+// Runs from the AsyncUDP task, so nothing has to poll it.
+class CaptiveDns
+{
+public:
+  CaptiveDns() : queries(0) {}
+
+  bool begin(IPAddress address, uint16_t port = 53);
+
+  // Queries answered since begin()
+  uint32_t answered() const
+  {
+    return queries.load(std::memory_order_relaxed);
+  }
+
+private:
+  void handle(AsyncUDPPacket &packet);
+
+  AsyncUDP udp;
+  IPAddress address;
+  std::atomic<uint32_t> queries;
+};
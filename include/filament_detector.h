@@ -0,0 +1,170 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include "running_stats.h"
+
+// Tracks whether filament is in the light path and latches one final value per insertion.
+//
+//   IDLE     nothing inserted, transmission is close to the baseline
+//   INSERTED transmission dropped, waiting a few samples to rule out a glitch
+//   SETTLING filament is in, sampling fast until the value is known well enough
+//   LATCHED  final value is held, only polling slowly for removal or a change
+//
+// While settling, the mean and variance of the plateau are tracked. Settling
+// ends as soon as the 95 % confidence interval of the mean is within
+// ci_tolerance, or the filter reports stable, whichever comes first. Easy
+// samples are done after a handful of readings, noisy ones get more of them.
+class FilamentDetector
+{
+public:
+  enum State : uint8_t
+  {
+    IDLE,
+    INSERTED,
+    SETTLING,
+    LATCHED,
+  };
+
+  struct Config
+  {
+    float present_below;     // transmission in percent that counts as inserted
+    float absent_above;      // transmission in percent that counts as removed again
+    float resettle_band;     // a latched value moving further than this gets measured again
+    uint8_t debounce;        // samples below present_below before settling starts
+    uint16_t settle_timeout; // samples after which SETTLING latches even if not stable
+    float plateau_band;      // a reading further than this from the running mean restarts the statistics
+    float ci_tolerance;      // confidence interval half width in percent that is good enough
+    uint8_t min_samples;     // plateau readings needed before the interval is trusted
+  };
+
+  explicit FilamentDetector(const Config &config)
+      : config(config), current(IDLE), counter(0), latched_value(0), latched_ci(INFINITY) {}
+
+  // Feeds one raw transmission through the filter and advances the state.
+  // The filter is reset whenever a new insertion starts, so readings of the
+  // empty tube never leak into a measurement.
+  template <typename Filter>
+  State update(float transmission, Filter &filter)
+  {
+    if (current != IDLE && transmission > config.absent_above)
+    {
+      current = IDLE;
+      filter.reset();
+    }
+
+    switch (current)
+    {
+    case IDLE:
+      if (transmission < config.present_below)
+      {
+        current = INSERTED;
+        counter = 0;
+        filter.reset();
+      }
+      break;
+    case INSERTED:
+      if (transmission >= config.present_below)
+      {
+        // Glitch, never mind
+        current = IDLE;
+      }
+      else if (++counter >= config.debounce)
+      {
+        startSettling();
+      }
+      break;
+    default:
+      break;
+    }
+
+    filter.update(transmission);
+
+    if (current == SETTLING)
+    {
+      // A reading far off the plateau means it is still moving, start over from it
+      if (stats.count() > 0 && difference(transmission, stats.mean()) > config.plateau_band)
+      {
+        stats.reset();
+      }
+      stats.add(transmission);
+      bool confident = stats.count() >= config.min_samples && stats.halfWidth() <= config.ci_tolerance;
+      if (confident || filter.stable() || ++counter >= config.settle_timeout)
+      {
+        current = LATCHED;
+        // The plateau mean doesn't carry the tail of the insertion like the EMA does
+        latched_value = stats.count() >= config.min_samples ? stats.mean() : filter.value();
+        latched_ci = stats.halfWidth();
+      }
+    }
+    // Checked on the median, the EMA may still be catching up when the interval ended settling early
+    else if (current == LATCHED && difference(filter.median(), latched_value) > config.resettle_band)
+    {
+      startSettling();
+    }
+    return current;
+  }
+
+  State state() const
+  {
+    return current;
+  }
+
+  // Value of the last measurement, kept until the next one latches
+  float latched() const
+  {
+    return latched_value;
+  }
+
+  // 95 % confidence interval half width in percent of the value being measured,
+  // or of the latched one. Infinite while there aren't enough readings.
+  float confidence() const
+  {
+    if (current == SETTLING)
+    {
+      return stats.halfWidth();
+    }
+    return current == LATCHED ? latched_ci : INFINITY;
+  }
+
+  // Only settling needs the fast rate, everything else can be polled slowly
+  bool needsFastSampling() const
+  {
+    return current == INSERTED || current == SETTLING;
+  }
+
+  static const char *stateName(State state)
+  {
+    switch (state)
+    {
+    case INSERTED:
+      return "inserted";
+    case SETTLING:
+      return "settling";
+    case LATCHED:
+      return "latched";
+    default:
+      return "idle";
+    }
+  }
+
+private:
+  void startSettling()
+  {
+    current = SETTLING;
+    counter = 0;
+    stats.reset();
+  }
+
+  static float difference(float a, float b)
+  {
+    return a > b ? a - b : b - a;
+  }
+
+  Config config;
+  State current;
+  uint16_t counter;
+  float latched_value;
+  float latched_ci;
+  RunningStats stats;
+};
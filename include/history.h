@@ -0,0 +1,270 @@
+#pragma once
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "measurement.h"
+
+#define HISTORY_SIZE 128
+#define LABEL_SIZE 32
+
+// One latched measurement
+struct Measurement
+{
+  uint32_t seq;          // running measurement number, starts at 0
+  uint32_t timestamp_ms; // millis() when it latched
+  uint8_t channel;       // light tube it was taken in
+  float transmission;    // latched transmission in percent
+  float ci;              // 95 % confidence interval half width of it, infinite if unknown
+  float td;              // HueForge TD of it
+  float lux;             // raw reading at that moment
+  float baseline;        // baseline it was computed against
+  char label[LABEL_SIZE];
+};
+
+// Pushed by the sensor task whenever a measurement latches, the oldest ones get overwritten
+extern SampleRing<Measurement, HISTORY_SIZE> history;
+
+// Label for the next measurement that latches in a channel, callable from any task
+void setPendingLabel(uint8_t channel, const char *label);
+
+// Stores a new measurement, consuming the channel's pending label. Sensor task only.
+void recordMeasurement(uint8_t channel, uint32_t timestamp_ms, float transmission, float ci, float td, float lux, float baseline);
+
+// Batch scanning. While a session runs, every measurement without a pending
+// label takes the next one of a queue posted up front, then a running number
+// once the queue is used up. The session's rows can be exported as one document.
+#define SESSION_QUEUE_SIZE 96
+
+struct SessionInfo
+{
+  bool active;
+  uint32_t first_seq; // first measurement that belongs to the session
+  uint32_t end_seq;   // one past its last, history.count() while it runs
+  uint32_t queued;    // labels left in the queue
+};
+
+// Starts a new session, ending any running one. labels is a newline or comma
+// separated list, empty for numbering only. Numbers are "<prefix> <n>".
+// False, with no session running, if there are more than SESSION_QUEUE_SIZE labels.
+bool startSession(const char *labels, const char *prefix);
+void endSession();
+// State of the running session, or of the last one after it ended
+SessionInfo sessionInfo();
+
+// Renders a snapshot of the history as CSV or JSON, piece by piece into
+// caller-provided buffers. Only one row is ever held in memory, so the cost
+// does not depend on how much history there is.
+template <size_t N>
+class HistoryExport
+{
+public:
+  enum Format
+  {
+    CSV,
+    JSON,
+    // Filament library import of HueForge, one filament per measurement
+    HUEFORGE,
+  };
+
+  // Covers measurements first_seq up to end_seq, as far as the ring still has them
+  HistoryExport(const SampleRing<Measurement, N> &ring, Format format, uint32_t first_seq = 0, uint32_t end_seq = UINT32_MAX)
+      : ring(&ring), format(format), phase(HEADER), rows(0), pending_len(0), pending_off(0)
+  {
+    end = ring.count() < end_seq ? ring.count() : end_seq;
+    next = end > N ? end - N : 0;
+    next = next > first_seq ? next : first_seq;
+  }
+
+  // Fills up to max_len bytes, returns 0 once the document is complete
+  size_t fill(uint8_t *buffer, size_t max_len)
+  {
+    size_t written = 0;
+    while (written < max_len)
+    {
+      if (pending_off == pending_len && !renderNext())
+      {
+        break;
+      }
+      size_t n = pending_len - pending_off;
+      if (n > max_len - written)
+      {
+        n = max_len - written;
+      }
+      memcpy(buffer + written, pending + pending_off, n);
+      pending_off += n;
+      written += n;
+    }
+    return written;
+  }
+
+private:
+  enum Phase
+  {
+    HEADER,
+    ROWS,
+    FOOTER,
+    DONE,
+  };
+
+  // Puts the next piece of the document into pending, false when there is none
+  bool renderNext()
+  {
+    pending_off = 0;
+    pending_len = 0;
+    switch (phase)
+    {
+    case HEADER:
+      append(format == CSV ? "seq,timestamp_ms,channel,transmission,ci,td,lux,baseline,label\n" : format == JSON ? "[" : "{\"Filaments\":[");
+      phase = ROWS;
+      return true;
+    case ROWS:
+      while (next < end)
+      {
+        Measurement m;
+        // Entries overwritten since the snapshot was taken are skipped
+        if (ring->read(next++, m))
+        {
+          renderRow(m, rows++ == 0);
+          return true;
+        }
+      }
+      phase = FOOTER;
+      // fall through
+    case FOOTER:
+      phase = DONE;
+      if (format != CSV)
+      {
+        append(format == JSON ? "]\n" : "]}\n");
+        return true;
+      }
+      return false;
+    default:
+      return false;
+    }
+  }
+
+  // Row layouts, every value goes in through %u or a preformatted %s
+#define HISTORY_CSV_ROW "%u,%u,%u,%s,%s,%s,%s,%s,\"%s\"\n"
+#define HISTORY_JSON_ROW "%s{\"seq\":%u,\"timestamp_ms\":%u,\"channel\":%u,\"transmission\":%s,\"ci\":%s," \
+                         "\"td\":%s,\"lux\":%s,\"baseline\":%s,\"label\":\"%s\"}"
+#define HISTORY_HUEFORGE_ROW "%s{\"Brand\":\"Generic\",\"Color\":\"#808080\",\"Name\":\"%s\",\"Owned\":true," \
+                             "\"Transmissivity\":%s,\"Type\":\"PLA\"}"
+
+  // Widest values: 32-bit numbers, floats as clamped by formatNumber() and a label of only quotes
+  static const size_t UINT_WIDTH = 10;
+  static const size_t CHANNEL_WIDTH = 3;
+  static const size_t FLOAT_WIDTH = 13; // -10000000.000
+  static const size_t LABEL_WIDTH = 2 * (LABEL_SIZE - 1);
+
+  // Longest rows: the layout without its conversions plus the widest values
+  static const size_t CSV_ROW_MAX = sizeof(HISTORY_CSV_ROW) - 1 - 2 * 9 + 2 * UINT_WIDTH + CHANNEL_WIDTH + 5 * FLOAT_WIDTH + LABEL_WIDTH;
+  static const size_t JSON_ROW_MAX = sizeof(HISTORY_JSON_ROW) - 1 - 2 * 10 + 1 + 2 * UINT_WIDTH + CHANNEL_WIDTH + 5 * FLOAT_WIDTH + LABEL_WIDTH;
+  static const size_t HUEFORGE_ROW_MAX = sizeof(HISTORY_HUEFORGE_ROW) - 1 - 2 * 3 + 1 + LABEL_WIDTH + FLOAT_WIDTH;
+  static_assert(CSV_ROW_MAX <= JSON_ROW_MAX && HUEFORGE_ROW_MAX <= JSON_ROW_MAX, "pending is sized for JSON rows");
+
+  void renderRow(const Measurement &m, bool is_first)
+  {
+    char label[LABEL_WIDTH + 1];
+    escape(m.label, format == CSV ? '"' : '\\', label);
+    const char *unknown = format == CSV ? "" : "null";
+    const char *separator = is_first ? "" : ",";
+    char td[FLOAT_WIDTH + 1];
+    formatNumber(td, m.td, format == HUEFORGE ? 1 : 2, unknown);
+    if (format == HUEFORGE)
+    {
+      // Color, brand and type aren't something a light tube can tell, they get fixed up in HueForge
+      appendf(HISTORY_HUEFORGE_ROW, separator, label, td);
+      return;
+    }
+    char transmission[FLOAT_WIDTH + 1];
+    char ci[FLOAT_WIDTH + 1];
+    char lux[FLOAT_WIDTH + 1];
+    char baseline[FLOAT_WIDTH + 1];
+    formatNumber(transmission, m.transmission, 2, unknown);
+    formatNumber(ci, m.ci, 3, unknown);
+    formatNumber(lux, m.lux, 2, unknown);
+    formatNumber(baseline, m.baseline, 2, unknown);
+    if (format == CSV)
+    {
+      appendf(HISTORY_CSV_ROW, (unsigned)m.seq, (unsigned)m.timestamp_ms, (unsigned)m.channel,
+              transmission, ci, td, lux, baseline, label);
+    }
+    else
+    {
+      appendf(HISTORY_JSON_ROW, separator, (unsigned)m.seq, (unsigned)m.timestamp_ms, (unsigned)m.channel,
+              transmission, ci, td, lux, baseline, label);
+    }
+  }
+
+  void put(char c)
+  {
+    if (pending_len < sizeof(pending))
+    {
+      pending[pending_len++] = c;
+    }
+  }
+
+  void append(const char *text)
+  {
+    for (; *text; text++)
+    {
+      put(*text);
+    }
+  }
+
+  // All or nothing, a cut row would break the whole document
+  void appendf(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
+  {
+    va_list args;
+    va_start(args, fmt);
+    size_t room = sizeof(pending) - pending_len;
+    int n = vsnprintf(pending + pending_len, room, fmt, args);
+    va_end(args);
+    if (n > 0 && (size_t)n < room)
+    {
+      pending_len += n;
+    }
+  }
+
+  // Unknown intervals are infinite and a broken baseline can give NaN, neither
+  // format can spell those. Everything else is clamped so it fits FLOAT_WIDTH.
+  static void formatNumber(char *out, float value, int decimals, const char *unknown)
+  {
+    if (!isfinite(value))
+    {
+      strcpy(out, unknown);
+      return;
+    }
+    value = fminf(fmaxf(value, -9999999.0f), 9999999.0f);
+    snprintf(out, FLOAT_WIDTH + 1, "%.*f", decimals, value);
+  }
+
+  // CSV doubles quotes, JSON puts a backslash in front of quotes and backslashes.
+  // out needs LABEL_WIDTH + 1 bytes.
+  static void escape(const char *text, char escape_char, char *out)
+  {
+    for (; *text; text++)
+    {
+      if (*text == '"' || (escape_char == '\\' && *text == '\\'))
+      {
+        *out++ = escape_char;
+      }
+      *out++ = *text;
+    }
+    *out = 0;
+  }
+
+  const SampleRing<Measurement, N> *ring;
+  Format format;
+  Phase phase;
+  uint32_t next;
+  uint32_t end;
+  uint32_t rows;
+  char pending[JSON_ROW_MAX + 1]; // vsnprintf needs room for the terminator
+  size_t pending_len;
+  size_t pending_off;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "light_sensor.h"
+
+// TCA9548A-style I2C multiplexer, lets several VEML7700 share their fixed address
+#ifndef I2C_MUX_ADDRESS
+#define I2C_MUX_ADDRESS 0x70
+#endif
+
+class I2cMux
+{
+public:
+  I2cMux() : selected(NO_CHANNEL) {}
+
+  // Starts the bus and checks the mux answers
+  bool begin();
+
+  // Routes the bus to one downstream channel, a no-op if it already is
+  bool select(uint8_t channel);
+
+private:
+  static const uint8_t NO_CHANNEL = 0xFF;
+
+  uint8_t selected;
+};
+
+// A sensor behind one mux channel, selects it before every access
+template <typename Inner>
+class MuxedSensor
+{
+public:
+  MuxedSensor() : mux(NULL), inner(NULL), channel(0) {}
+
+  void attach(I2cMux &mux, Inner &inner, uint8_t channel)
+  {
+    this->mux = &mux;
+    this->inner = &inner;
+    this->channel = channel;
+  }
+
+  bool begin()
+  {
+    return mux->select(channel) && inner->begin();
+  }
+
+  void setRange(const RangeSetting &setting)
+  {
+    mux->select(channel);
+    inner->setRange(setting);
+  }
+
+  uint8_t gain()
+  {
+    mux->select(channel);
+    return inner->gain();
+  }
+
+  uint8_t integrationTime()
+  {
+    mux->select(channel);
+    return inner->integrationTime();
+  }
+
+  bool read(RawReading &reading)
+  {
+    return mux->select(channel) && inner->read(reading);
+  }
+
+  float readLux()
+  {
+    mux->select(channel);
+    return inner->readLux();
+  }
+
+private:
+  I2cMux *mux;
+  Inner *inner;
+  uint8_t channel;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include "auto_range.h"
+
+// Both channels of one conversion, in raw counts
+struct RawReading
+{
+  uint16_t als;
+  uint16_t white;
+};
+
+// What the sampling code needs from an ambient light sensor. There is no base
+// class: the sensor type is fixed per build (see main.cpp), so the sampling path
+// calls it directly and the small ones inline. Every sensor type provides
+//
+//   bool begin();
+//   // Applies a gain/integration time combination for the following reads
+//   void setRange(const RangeSetting &setting);
+//   // Register codes of the active gain and integration time
+//   uint8_t gain();
+//   uint8_t integrationTime();
+//   // Raw counts of the last finished conversion. Pacing is up to the caller,
+//   // one read per integration time gives a fresh conversion every time.
+//   // False if the sensor didn't answer, reading is undefined then.
+//   bool read(RawReading &reading);
+//   // Lux as converted by the driver itself, used when ADAPTIVE_RANGE is off
+//   float readLux();
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include "sample_ring.h"
+
+// Light tubes, each with its own sensor. More than one needs a TCA9548A mux,
+// sensor i is on mux channel i.
+#ifndef SENSOR_CHANNELS
+#define SENSOR_CHANNELS 1
+#endif
+static_assert(SENSOR_CHANNELS >= 1 && SENSOR_CHANNELS <= 8, "the mux has 8 channels");
+
+// Written by the sensor task only, everything else reads snapshots from here.
+// Samples of all channels are interleaved, one per channel and scan.
+#define SAMPLE_RING_SIZE (64 * SENSOR_CHANNELS)
+extern SampleRing<Sample, SAMPLE_RING_SIZE> samples;
+
+// Newest sample of one channel, false if it has none in the last few scans
+inline bool latestSample(uint8_t channel, Sample &out)
+{
+  uint32_t n = samples.count();
+  for (uint32_t i = n; i > 0 && n - i < 4 * SENSOR_CHANNELS; i--)
+  {
+    if (samples.read(i - 1, out) && out.channel == channel)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Set from the web side, the sensor task recalibrates before its next sample
+extern std::atomic<bool> calibrate_requested;
+
+// What the sensor side is up to, set by the sensor task
+enum DeviceStatus : uint8_t
+{
+  STATUS_CALIBRATING, // starting up or taking a new baseline, no samples yet
+  STATUS_READY,
+  STATUS_NO_SENSOR, // sensor didn't answer, retried every few seconds
+};
+extern std::atomic<uint8_t> device_status;
+
+inline const char *deviceStatusName(uint8_t status)
+{
+  switch (status)
+  {
+  case STATUS_CALIBRATING:
+    return "calibrating";
+  case STATUS_NO_SENSOR:
+    return "no_sensor";
+  default:
+    return "ready";
+  }
+}
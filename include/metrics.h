@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+class Print;
+
+// Fixed-bucket histogram of durations in microseconds.
+// observe() is a few compares and two relaxed atomic adds, so it can sit on
+// the sampling path and in request handlers from any task.
+class Histogram
+{
+public:
+  static const size_t BOUND_COUNT = 13;
+  // Upper bounds of the buckets, the last bucket catches everything above
+  static const uint32_t BOUNDS_US[BOUND_COUNT];
+
+  Histogram() : sum_us(0)
+  {
+    for (size_t i = 0; i <= BOUND_COUNT; i++)
+    {
+      buckets[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void observe(uint32_t duration_us)
+  {
+    size_t i = 0;
+    while (i < BOUND_COUNT && duration_us > BOUNDS_US[i])
+    {
+      i++;
+    }
+    buckets[i].fetch_add(1, std::memory_order_relaxed);
+    sum_us.fetch_add(duration_us, std::memory_order_relaxed);
+  }
+
+  // Observations in bucket i alone, i == BOUND_COUNT is the overflow bucket
+  uint32_t bucket(size_t i) const
+  {
+    return buckets[i].load(std::memory_order_relaxed);
+  }
+
+  // 64 bits, so the counter Prometheus sees never wraps (32 bits of us would after 71 minutes)
+  uint64_t sum() const
+  {
+    return sum_us.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<uint32_t> buckets[BOUND_COUNT + 1];
+  std::atomic<uint64_t> sum_us;
+};
+
+struct Metrics
+{
+  Histogram loop;           // work done per loop() iteration
+  Histogram sensor_read;    // one lux reading, range retries included
+  Histogram http_root;      // handleRoot service time
+  Histogram http_not_found; // handleNotFound service time
+  std::atomic<uint32_t> missed_ticks; // sample clock ticks that came before the last read was done
+  std::atomic<uint32_t> stream_dropped; // samples gone from the ring before the serial stream sent them
+  std::atomic<uint32_t> sensor_errors; // reads a sensor (or the mux) didn't answer
+};
+
+extern Metrics metrics;
+
+// Prometheus text exposition of everything above plus heap, DNS and soft-AP gauges
+void writeMetrics(Print &out);
@@ -0,0 +1,18 @@
+#pragma once
+
+class AsyncWebServer;
+
+// HTTP basic auth for everything that changes the firmware or the network.
+// There is no default password: without -DOTA_PASSWORD every device makes up
+// its own on first boot, keeps it in NVS and prints it on the serial port at
+// every boot, so only someone with the device at hand learns it.
+#ifndef OTA_USERNAME
+#define OTA_USERNAME "admin"
+#endif
+
+// The build's OTA_PASSWORD or the device's own, valid once setupOta() ran
+const char *adminPassword();
+
+// POST /update?md5=<hex digest>: firmware upload straight into the inactive OTA
+// slot, checked against the digest before it boots
+void setupOta(AsyncWebServer &server);
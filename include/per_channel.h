@@ -0,0 +1,43 @@
+#pragma once
+
+#include <new>
+#include <stddef.h>
+#include <type_traits>
+
+// N objects of a type without a default constructor, all built from the same
+// arguments. Lets the per-channel state stay plain arrays of the existing
+// pipeline classes.
+template <typename T, size_t N>
+class PerChannel
+{
+public:
+  template <typename... Args>
+  explicit PerChannel(const Args &...args)
+  {
+    for (size_t i = 0; i < N; i++)
+    {
+      new (&storage[i]) T(args...);
+    }
+  }
+
+  ~PerChannel()
+  {
+    for (size_t i = 0; i < N; i++)
+    {
+      (*this)[i].~T();
+    }
+  }
+
+  T &operator[](size_t i)
+  {
+    return reinterpret_cast<T *>(storage)[i];
+  }
+
+  const T &operator[](size_t i) const
+  {
+    return reinterpret_cast<const T *>(storage)[i];
+  }
+
+private:
+  typename std::aligned_storage<sizeof(T), alignof(T)>::type storage[N];
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+// Drops the CPU clock while nothing is going on: no filament being measured,
+// no HTTP request for a while, no /events subscriber and no serial stream.
+// loop() then waits longer between passes and, on a joined network, the
+// modem sleeps between beacons. Anything that needs the device brings it
+// back to full speed right away via wakeUp().
+void setupPower();
+
+// Full speed now, callable from any task. Cheap when already awake.
+void wakeUp();
+
+// Ends loop(): waits until the next pass, short while busy, long while idle or until wakeUp()
+void powerWait();
+
+// Current CPU clock in MHz, for /metrics
+uint32_t cpuMhz();
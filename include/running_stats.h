@@ -0,0 +1,71 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+// Running mean and variance (Welford), numerically stable in float and O(1) per value
+class RunningStats
+{
+public:
+  RunningStats()
+  {
+    reset();
+  }
+
+  void reset()
+  {
+    n = 0;
+    mean_value = 0;
+    m2 = 0;
+  }
+
+  void add(float value)
+  {
+    n++;
+    float delta = value - mean_value;
+    mean_value += delta / n;
+    m2 += delta * (value - mean_value);
+  }
+
+  uint16_t count() const
+  {
+    return n;
+  }
+
+  float mean() const
+  {
+    return mean_value;
+  }
+
+  // Sample variance, 0 until there are two values
+  float variance() const
+  {
+    return n > 1 ? m2 / (n - 1) : 0;
+  }
+
+  // Half width of the 95 % confidence interval of the mean, infinite below two values
+  float halfWidth() const
+  {
+    if (n < 2)
+    {
+      return INFINITY;
+    }
+    return studentT(n - 1) * sqrtf(variance() / n);
+  }
+
+private:
+  // Two-sided 97.5 % quantile of Student's t, rounded up between the table entries
+  static float studentT(uint16_t degrees)
+  {
+    static const float table[] = {12.71f, 4.30f, 3.18f, 2.78f, 2.57f, 2.45f, 2.36f, 2.31f, 2.26f, 2.23f};
+    if (degrees <= 10)
+    {
+      return table[degrees - 1];
+    }
+    return degrees <= 20 ? 2.23f : degrees <= 30 ? 2.09f : 2.04f;
+  }
+
+  uint16_t n;
+  float mean_value;
+  float m2;
+};
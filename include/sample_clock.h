@@ -0,0 +1,39 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include <esp_timer.h>
+
+// Periodic esp_timer that paces sensor reads.
+//
+// Every tick gives the waiting task a notification, and FreeRTOS counts those
+// for us. The timer needs no locking, and wait() knows if ticks were missed.
+// The period is meant to match the sensor's integration time, so each tick
+// finds a fresh conversion.
+class SampleClock
+{
+public:
+  SampleClock() : timer(NULL), task(NULL), period_ms(0) {}
+
+  // Creates the timer, later calls only change the period
+  bool begin(uint32_t period_ms);
+
+  // Restarts the timer with a new period, ticks of the old one are dropped.
+  // Must be called from the task that waits.
+  void setPeriod(uint32_t period_ms);
+
+  uint32_t period() const
+  {
+    return period_ms;
+  }
+
+  // Blocks until the next tick, returns how many ticks were missed before it
+  uint32_t wait();
+
+private:
+  static void onTick(void *arg);
+
+  esp_timer_handle_t timer;
+  std::atomic<TaskHandle_t> task;
+  uint32_t period_ms;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "filament_detector.h"
+#include "sample_ring.h"
+
+// The object served by /api/td and pushed to /events, formatted into a caller buffer
+inline int formatSampleJson(char *buf, size_t size, const Sample &sample)
+{
+  // An unknown interval is infinite, JSON has no spelling for that
+  char ci[12] = "null";
+  if (!isinf(sample.confidence))
+  {
+    snprintf(ci, sizeof(ci), "%.3f", sample.confidence);
+  }
+  return snprintf(buf, size, "{\"channel\":%u,\"td\":%.2f,\"hueforge_td\":%.2f,\"stable\":%s,\"state\":\"%s\",\"latched\":%.2f,\"ci\":%s}",
+                  (unsigned)sample.channel, sample.filtered, sample.td, sample.stable ? "true" : "false",
+                  FilamentDetector::stateName(static_cast<FilamentDetector::State>(sample.state)), sample.latched, ci);
+}
+
+// Same keys while there is no value to report, state says why
+inline int formatStatusJson(char *buf, size_t size, uint8_t channel, const char *state)
+{
+  return snprintf(buf, size, "{\"channel\":%u,\"td\":null,\"hueforge_td\":null,\"stable\":false,\"state\":\"%s\",\"latched\":null,\"ci\":null}",
+                  (unsigned)channel, state);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// One processed reading as published by the sensor task
+struct Sample
+{
+  uint32_t seq;          // running sample number, starts at 0
+  uint32_t timestamp_ms; // millis() when the sample was taken
+  uint8_t channel;       // light tube it belongs to, 0 without a mux
+  float lux;             // sensor reading converted to lux
+  uint16_t als;          // raw ALS count, 0 when ADAPTIVE_RANGE is off
+  uint16_t white;        // raw WHITE count, 0 when ADAPTIVE_RANGE is off
+  float baseline;        // empty-tube lux the transmission is relative to
+  float transmission;    // lux relative to the baseline, in percent
+  float filtered;        // transmission after median + EMA
+  float td;              // HueForge TD of filtered
+  bool stable;           // filtered has settled
+  uint8_t state;         // FilamentDetector::State
+  float latched;         // last latched measurement
+  float confidence;      // 95 % interval half width of the settling or latched value, infinite if unknown
+};
+
+// Fixed-size single-producer/multi-consumer ring buffer.
+//
+// The producer never waits: every slot carries its own version which is odd
+// while the slot is being written and 2 * (index + 1) once sample `index` is
+// complete. Readers copy the slot and check the version before and after, so
+// they either get a consistent copy or notice it was overwritten meanwhile.
+// Only plain 32-bit atomic loads and stores are used, which are lock-free on
+// both the ESP32 and the ESP32-C3.
+template <typename T, size_t N>
+class SampleRing
+{
+public:
+  SampleRing() : head(0)
+  {
+    for (size_t i = 0; i < N; i++)
+    {
+      slots[i].version.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  // Only ever called from the one producer task
+  void push(const T &value)
+  {
+    uint32_t index = head.load(std::memory_order_relaxed);
+    Slot &slot = slots[index % N];
+    slot.version.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&slot.value, &value, sizeof(T));
+    slot.version.store(2 * (index + 1), std::memory_order_release);
+    head.store(index + 1, std::memory_order_release);
+  }
+
+  // Number of samples pushed so far, the newest one has index count() - 1
+  uint32_t count() const
+  {
+    return head.load(std::memory_order_acquire);
+  }
+
+  // Copies sample `index` into out. Fails if it wasn't pushed yet or
+  // has already been overwritten by a newer one.
+  bool read(uint32_t index, T &out) const
+  {
+    uint32_t n = count();
+    if (index >= n || n - index > N)
+    {
+      return false;
+    }
+    const Slot &slot = slots[index % N];
+    uint32_t expected = 2 * (index + 1);
+    if (slot.version.load(std::memory_order_acquire) != expected)
+    {
+      return false;
+    }
+    memcpy(&out, &slot.value, sizeof(T));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.version.load(std::memory_order_relaxed) == expected;
+  }
+
+  // Copies the newest sample into out, false while nothing was pushed yet
+  bool latest(T &out) const
+  {
+    for (;;)
+    {
+      uint32_t n = count();
+      if (n == 0)
+      {
+        return false;
+      }
+      if (read(n - 1, out))
+      {
+        return true;
+      }
+      // The producer lapped us, which needs N pushes during one copy. Just retry.
+    }
+  }
+
+  static constexpr size_t capacity()
+  {
+    return N;
+  }
+
+private:
+  struct Slot
+  {
+    std::atomic<uint32_t> version;
+    T value;
+  };
+
+  Slot slots[N];
+  std::atomic<uint32_t> head;
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+// Binary sample stream over the USB CDC serial port, see stream_frame.h.
+// Off after boot so the debug prints stay readable, the host sends 'S' to
+// start it and 'X' to stop it again.
+void setupSerialStream();
+
+// Called from loop(). Never waits: it only writes what the port can take right now.
+void loopSerialStream();
+
+// Whether the host asked for the stream
+bool serialStreaming();
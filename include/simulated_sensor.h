@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include "light_sensor.h"
+
+// Replays a recorded lux trace instead of talking to hardware, so the web side
+// can be loaded without a light tube. Reads report counts for the active range,
+// which keeps the range selection honest as well. WHITE is simulated as a fixed
+// ratio of ALS.
+class SimulatedSensor
+{
+public:
+  // Moves on to the next trace point every step_ms, wrapping around at the end
+  SimulatedSensor(const float *trace, size_t length, uint32_t step_ms);
+
+  bool begin();
+  void setRange(const RangeSetting &setting);
+  uint8_t gain();
+  uint8_t integrationTime();
+  bool read(RawReading &reading);
+  float readLux();
+
+private:
+  float currentLux();
+
+  const float *trace;
+  size_t length;
+  uint32_t step_ms;
+  uint32_t start_ms;
+  uint32_t noise;
+  RangeSetting range;
+};
+
+// Empty tube, a few insertions of different filaments and the removals in between,
+// one point per 100 ms
+extern const float recorded_trace[];
+extern const size_t recorded_trace_length;
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// Two-channel correction of the ALS count against light outside the band it
+// is meant to see. WHITE covers a much wider band, so ALS - WHITE grows with
+// whatever the ALS filter only partly blocks (the blue LED peak, near IR
+// through red and orange filament):
+//
+//   corrected = ALS + k * (ALS - WHITE)
+//
+// Transmission is a ratio against the empty-tube baseline, which goes through
+// the same kernel, so only the difference in color between the LED alone and
+// the LED through filament has an effect. k depends on the LED and the tube
+// and has to be measured against reference filaments, 0 leaves ALS untouched.
+// This is the value until one is set with POST /api/spectral.
+#ifndef SPECTRAL_WEIGHT
+#define SPECTRAL_WEIGHT 0.0
+#endif
+
+// Largest |k| accepted at runtime, far beyond anything a real tube needs
+#define SPECTRAL_WEIGHT_MAX 8.0f
+
+// k in Q16, rounded
+inline int32_t spectralWeightQ16(float k)
+{
+  return (int32_t)(k * 65536.0f + (k < 0 ? -0.5f : 0.5f));
+}
+
+// Integer only: two multiplies and a shift per sample, clamped to the count range
+inline uint16_t spectralCorrect(uint16_t als, uint16_t white, int32_t weight_q16)
+{
+  if (weight_q16 == 0)
+  {
+    return als;
+  }
+  int64_t q16 = (int64_t)als * (65536 + weight_q16) - (int64_t)white * weight_q16;
+  int64_t corrected = (q16 + 32768) >> 16;
+  if (corrected < 0)
+  {
+    return 0;
+  }
+  return corrected > 65535 ? 65535 : (uint16_t)corrected;
+}
+
+// k in Q16, written from the web side. The sensor task recalibrates every
+// channel when it changes, the baselines have to be taken with the same k.
+extern std::atomic<int32_t> spectral_weight_q16;
+
+// Puts a k stored in NVS in place, if there is one
+void loadStoredSpectralWeight();
+
+// Sets and stores k. False if it isn't a number within SPECTRAL_WEIGHT_MAX.
+bool setSpectralWeight(const char *weight);
+
+// Back to SPECTRAL_WEIGHT, also after a reboot
+void clearSpectralWeight();
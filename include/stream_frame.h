@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "sample_ring.h"
+
+// Binary record of one sample for the serial stream, little endian:
+//
+//   0  2  sync 0xA5 0x5A
+//   2  1  format version
+//   3  1  payload length, everything up to the CRC
+//   4  4  seq
+//   8  4  timestamp_ms
+//  12  4  lux (float)
+//  16  4  filtered transmission in percent (float)
+//  20  4  HueForge TD (float)
+//  24  1  FilamentDetector::State
+//  25  1  flags, bit 0 = stable, bits 4..7 = channel
+//  26  2  CRC-16/CCITT-FALSE over bytes 2..25
+//
+// The sync bytes only help finding the start again, a frame counts once its CRC matches.
+#define STREAM_FRAME_SIZE 28
+#define STREAM_FRAME_VERSION 1
+#define STREAM_SYNC_0 0xA5
+#define STREAM_SYNC_1 0x5A
+
+inline uint16_t crc16Ccitt(const uint8_t *data, size_t length)
+{
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < length; i++)
+  {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int bit = 0; bit < 8; bit++)
+    {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+// Both targets are little endian, so the fields are copied as they are in memory
+inline void encodeStreamFrame(uint8_t *frame, const Sample &sample)
+{
+  frame[0] = STREAM_SYNC_0;
+  frame[1] = STREAM_SYNC_1;
+  frame[2] = STREAM_FRAME_VERSION;
+  frame[3] = STREAM_FRAME_SIZE - 4 - 2;
+  memcpy(frame + 4, &sample.seq, 4);
+  memcpy(frame + 8, &sample.timestamp_ms, 4);
+  memcpy(frame + 12, &sample.lux, 4);
+  memcpy(frame + 16, &sample.filtered, 4);
+  memcpy(frame + 20, &sample.td, 4);
+  frame[24] = sample.state;
+  frame[25] = (sample.stable ? 1 : 0) | (sample.channel << 4);
+  uint16_t crc = crc16Ccitt(frame + 2, STREAM_FRAME_SIZE - 4);
+  frame[26] = crc & 0xFF;
+  frame[27] = crc >> 8;
+}
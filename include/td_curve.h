@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Transmission (0..100 %, 1 % steps) to HueForge TD, interpolated linearly in between.
+//
+// The default curve treats the filament as a Beer-Lambert absorber: with T
+// measured through a 1.75 mm strand and TD being the thickness that lets 10 %
+// of the light through, TD = 1.75 * ln(0.1) / ln(T). Capped at 100.
+#define TD_CURVE_POINTS 101
+#define TD_CURVE_MAX 100.0f
+// Most points a user curve can be given with
+#define TD_CURVE_MAX_INPUT 32
+
+// Maps transmission to TD for every sample, with an optional user curve.
+//
+// A user curve is resampled onto the same grid when it is loaded, so map() is
+// always the same clamp, index and lerp, no searching and no branches. It goes
+// into whichever of the two preallocated tables is not active and is then
+// published with one atomic pointer swap.
+//
+// The thread that maps may still be in the middle of a map() on the table that
+// was active before the swap. It calls acknowledge() whenever it has no map()
+// running, and until it did, busy() is true and loads are refused, so a second
+// load can never write into a table that is being read.
+class TdCurve
+{
+public:
+  static constexpr float DEFAULT_CURVE[TD_CURVE_POINTS] = {
+      0.000f, 0.875f, 1.030f, 1.149f, 1.252f, 1.345f, 1.432f, 1.515f, 1.595f, 1.673f,
+      1.750f, 1.826f, 1.900f, 1.975f, 2.049f, 2.124f, 2.199f, 2.274f, 2.350f, 2.426f,
+      2.504f, 2.582f, 2.661f, 2.742f, 2.824f, 2.907f, 2.991f, 3.078f, 3.165f, 3.255f,
+      3.347f, 3.441f, 3.536f, 3.635f, 3.735f, 3.838f, 3.944f, 4.053f, 4.165f, 4.279f,
+      4.398f, 4.519f, 4.645f, 4.774f, 4.908f, 5.046f, 5.189f, 5.337f, 5.490f, 5.649f,
+      5.813f, 5.984f, 6.162f, 6.347f, 6.539f, 6.740f, 6.950f, 7.168f, 7.397f, 7.637f,
+      7.888f, 8.152f, 8.429f, 8.721f, 9.029f, 9.354f, 9.698f, 10.062f, 10.448f, 10.859f,
+      11.297f, 11.765f, 12.266f, 12.804f, 13.382f, 14.007f, 14.683f, 15.417f, 16.218f, 17.094f,
+      18.058f, 19.123f, 20.305f, 21.626f, 23.111f, 24.794f, 26.717f, 28.935f, 31.522f, 34.578f,
+      38.245f, 42.726f, 48.326f, 55.525f, 65.123f, 78.558f, 98.710f, 100.000f, 100.000f, 100.000f,
+      100.000f,
+  };
+
+  TdCurve() : active(DEFAULT_CURVE), generation(0), acknowledged(0) {}
+
+  float map(float transmission) const
+  {
+    const float *table = active.load(std::memory_order_acquire);
+    // Clamp to [0, 100) so index + 1 is always valid, NaN ends up at 0
+    float x = fminf(fmaxf(transmission, 0.0f), 99.999f);
+    int i = (int)x;
+    float frac = x - i;
+    return table[i] + frac * (table[i + 1] - table[i]);
+  }
+
+  // Points as (transmission %, TD) pairs, transmission strictly increasing.
+  // Outside the given range the first/last TD is held. Returns false when the
+  // points can't describe a curve or while busy(), the active one stays in place then.
+  // Only one thread may load at a time.
+  bool load(const float *transmission, const float *td, size_t count)
+  {
+    if (count < 2 || busy())
+    {
+      return false;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+      if (!(transmission[i] >= 0 && transmission[i] <= 100 && td[i] >= 0) ||
+          (i > 0 && !(transmission[i] > transmission[i - 1])))
+      {
+        return false;
+      }
+    }
+
+    float *table = active.load() == user[0] ? user[1] : user[0];
+    size_t segment = 0;
+    for (size_t p = 0; p < TD_CURVE_POINTS; p++)
+    {
+      float t = (float)p;
+      while (segment + 2 < count && t > transmission[segment + 1])
+      {
+        segment++;
+      }
+      float t0 = transmission[segment];
+      float t1 = transmission[segment + 1];
+      float f = (t - t0) / (t1 - t0);
+      f = fminf(fmaxf(f, 0.0f), 1.0f);
+      table[p] = fminf(td[segment] + f * (td[segment + 1] - td[segment]), TD_CURVE_MAX);
+    }
+    publish(table);
+    return true;
+  }
+
+  // Copies the grid of an already resampled curve, as stored by table(). False while busy().
+  bool loadTable(const float *points)
+  {
+    if (busy())
+    {
+      return false;
+    }
+    float *table = active.load() == user[0] ? user[1] : user[0];
+    memcpy(table, points, sizeof(user[0]));
+    publish(table);
+    return true;
+  }
+
+  // Nothing gets written, so this works while busy() as well
+  void reset()
+  {
+    publish(DEFAULT_CURVE);
+  }
+
+  // The mapping thread may still read the table that was active before the last swap
+  bool busy() const
+  {
+    return acknowledged.load(std::memory_order_acquire) != generation.load(std::memory_order_acquire);
+  }
+
+  // Called by the thread that maps, at a point where none of its map() calls is running.
+  // The ones after it only see tables published so far.
+  void acknowledge()
+  {
+    acknowledged.store(generation.load(std::memory_order_acquire), std::memory_order_release);
+  }
+
+  bool isDefault() const
+  {
+    return active.load() == DEFAULT_CURVE;
+  }
+
+  // The active grid, TD_CURVE_POINTS values
+  const float *table() const
+  {
+    return active.load();
+  }
+
+private:
+  void publish(const float *table)
+  {
+    active.store(table, std::memory_order_release);
+    generation.fetch_add(1, std::memory_order_acq_rel);
+  }
+
+  std::atomic<const float *> active;
+  std::atomic<uint32_t> generation;   // swaps so far
+  std::atomic<uint32_t> acknowledged; // generation the mapping thread last acknowledged
+  float user[2][TD_CURVE_POINTS];
+};
+
+extern TdCurve td_curve;
+
+// Puts a user curve stored in NVS in place, if there is one
+void loadStoredCurve();
+
+// Parses "t:td,t:td,..." pairs, loads and stores them. False if they don't make
+// a curve, or while td_curve.busy().
+bool setUserCurve(const char *points);
+
+// Back to the default curve, also after a reboot
+void clearUserCurve();
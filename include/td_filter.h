@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stddef.h>
+
+// Running median followed by an exponential moving average.
+//
+// The median drops single outliers, the EMA smooths what is left. Both
+// window lengths are template parameters, so all state is a pair of fixed
+// arrays and the EMA factor is a compile time constant.
+template <size_t MedianWindow, size_t EmaWindow>
+class TdFilter
+{
+public:
+  static_assert(MedianWindow % 2 == 1, "median window has to be odd");
+  static_assert(MedianWindow > 0 && EmaWindow > 0, "windows can't be empty");
+
+  // Output counts as stable once the whole median window and the EMA are within
+  // stable_band of each other, in the unit of the input
+  explicit TdFilter(float stable_band) : band(stable_band)
+  {
+    reset();
+  }
+
+  void reset()
+  {
+    count = 0;
+    next = 0;
+    ema = 0;
+  }
+
+  // Feeds one raw value, returns the filtered one
+  float update(float value)
+  {
+    if (value != value)
+    {
+      // NaN would never be found again in sorted[]
+      return ema;
+    }
+    if (count < MedianWindow)
+    {
+      insertSorted(count, value);
+      window[count++] = value;
+    }
+    else
+    {
+      replaceSorted(window[next], value);
+      window[next] = value;
+      next = (next + 1) % MedianWindow;
+    }
+
+    float m = median();
+    // Start the EMA on the first median instead of creeping up from 0
+    ema = count == 1 ? m : ema + ALPHA * (m - ema);
+    return ema;
+  }
+
+  float value() const
+  {
+    return ema;
+  }
+
+  float median() const
+  {
+    return sorted[count / 2];
+  }
+
+  bool stable() const
+  {
+    return count == MedianWindow &&
+           sorted[MedianWindow - 1] - sorted[0] <= band &&
+           (ema > median() ? ema - median() : median() - ema) <= band;
+  }
+
+private:
+  static constexpr float ALPHA = 2.0f / (EmaWindow + 1);
+
+  // sorted[0..n) is in order, make room for value and keep it that way
+  void insertSorted(size_t n, float value)
+  {
+    size_t i = n;
+    while (i > 0 && sorted[i - 1] > value)
+    {
+      sorted[i] = sorted[i - 1];
+      i--;
+    }
+    sorted[i] = value;
+  }
+
+  // Swaps the oldest value for the new one, shifting the neighbours so the order holds
+  void replaceSorted(float old_value, float value)
+  {
+    size_t i = 0;
+    while (sorted[i] != old_value)
+    {
+      i++;
+    }
+    while (i > 0 && sorted[i - 1] > value)
+    {
+      sorted[i] = sorted[i - 1];
+      i--;
+    }
+    while (i + 1 < MedianWindow && sorted[i + 1] < value)
+    {
+      sorted[i] = sorted[i + 1];
+      i++;
+    }
+    sorted[i] = value;
+  }
+
+  float window[MedianWindow]; // in arrival order, next is the oldest once full
+  float sorted[MedianWindow];
+  size_t count;
+  size_t next;
+  float ema;
+  float band;
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+// Sends every new sample as one UDP datagram to the local network, in the
+// frame layout of stream_frame.h. Listeners only have to join the group (or
+// bind the port for broadcast), the device pays one send per sample no
+// matter how many there are.
+void setupTelemetry();
+
+// POST /api/telemetry with enabled=0/1 switches it, the choice is kept in NVS.
+// Until then it is on with the soft-AP and off on a stored network.
+// Called from the web side while loopTelemetry() runs.
+void setTelemetryEnabled(bool enabled);
+
+// Called from loop(), after setupWeb() brought WiFi up
+void loopTelemetry();
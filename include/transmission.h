@@ -0,0 +1,11 @@
+#pragma once
+
+// Light reaching the sensor relative to the empty-tube baseline, in percent
+inline float transmissionPercent(float lux, float baseline)
+{
+  if (baseline == 0)
+  {
+    return 0; // Avoid division by zero
+  }
+  return (lux / baseline) * 100.0f;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Adafruit_VEML7700.h"
+#include "board.h"
+#include "light_sensor.h"
+
+// Pins from the assembly instructions in the README
+#ifndef I2C_SDA_PIN
+#define I2C_SDA_PIN Board::I2C_SDA
+#endif
+#ifndef I2C_SCL_PIN
+#define I2C_SCL_PIN Board::I2C_SCL
+#endif
+// The VEML7700 supports fast mode
+#ifndef I2C_FREQUENCY
+#define I2C_FREQUENCY 400000
+#endif
+
+// The real VEML7700. The Adafruit library does the setup, samples are read
+// straight from the result registers: ALS and WHITE in two back-to-back
+// transactions, without asking the sensor for its integration time first.
+class VemlSensor
+{
+public:
+  bool begin();
+  void setRange(const RangeSetting &setting);
+  uint8_t gain();
+  uint8_t integrationTime();
+  bool read(RawReading &reading);
+  float readLux();
+
+private:
+  bool readRegister(uint8_t reg, uint16_t &value);
+
+  Adafruit_VEML7700 veml;
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// WiFi (see wifi_config.h) and the async HTTP server
+void setupWeb();
+
+// Called from loop(), pushes new values to /events and never waits on the sensor
+void loopWeb();
+
+// Reboots from loop() shortly, once the current response went out
+void restartSoon();
+
+// Clients subscribed to /events right now
+size_t eventSubscribers();
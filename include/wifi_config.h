@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+class AsyncWebServer;
+
+// Joins the network stored in NVS and announces itself as td-free.local.
+// Without credentials, or if joining fails, it opens the "Td-Free" soft-AP
+// with the captive portal DNS instead. Blocks until either is up.
+void setupWifi();
+
+// True when joined to a network, false in soft-AP mode
+bool stationMode();
+
+// POST /api/wifi with ssid and password stores the network, DELETE
+// /api/wifi forgets it. Both reboot to apply it, and need the OTA credentials.
+void setupWifiRoutes(AsyncWebServer &server);
+
+// Captive portal DNS queries answered so far, stays 0 in station mode
+uint32_t dnsQueries();
@@ -0,0 +1,24 @@
+# Gzips the web assets before they get embedded into the firmware, see
+# board_build.embed_files in platformio.ini
+import gzip
+import os
+
+Import("env")
+
+ASSETS = ["src/html/index.html"]
+
+
+def compress(source):
+    target = source + ".gz"
+    if os.path.exists(target) and os.path.getmtime(target) >= os.path.getmtime(source):
+        return
+    with open(source, "rb") as f:
+        data = f.read()
+    # mtime=0 keeps the output byte-identical between builds, so the ETag stays the same too
+    with open(target, "wb") as f:
+        f.write(gzip.compress(data, compresslevel=9, mtime=0))
+    print("Compressed %s: %d -> %d bytes" % (source, len(data), os.path.getsize(target)))
+
+
+for asset in ASSETS:
+    compress(os.path.join(env.subst("$PROJECT_DIR"), asset))
@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+"""Load test for the Td-Free web server.
+
+Runs N HTTP clients requesting a path in a loop and M Server-Sent Events
+listeners on /events at the same time, then reports latency percentiles and
+throughput. Best run against the mini_c3_sim env, so the sensor side
+produces values without a light tube.
+
+    python3 scripts/loadtest.py --host 192.168.0.1 --clients 8 --sse 4 --duration 30
+"""
+import argparse
+import asyncio
+import time
+
+
+async def http_get(host, port, path):
+    reader, writer = await asyncio.open_connection(host, port)
+    writer.write(("GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n" % (path, host)).encode())
+    await writer.drain()
+    status = await reader.readline()
+    await reader.read()
+    writer.close()
+    return int(status.split()[1])
+
+
+async def http_client(args, latencies, errors, deadline):
+    while time.monotonic() < deadline:
+        start = time.monotonic()
+        try:
+            status = await asyncio.wait_for(http_get(args.host, args.port, args.path), args.timeout)
+            if status >= 400:
+                errors.append(status)
+            else:
+                latencies.append(time.monotonic() - start)
+        except (OSError, asyncio.TimeoutError) as e:
+            errors.append(type(e).__name__)
+
+
+async def sse_client(args, intervals, errors, deadline):
+    try:
+        reader, writer = await asyncio.open_connection(args.host, args.port)
+        writer.write(("GET /events HTTP/1.1\r\nHost: %s\r\nAccept: text/event-stream\r\n\r\n" % args.host).encode())
+        await writer.drain()
+        last = None
+        while time.monotonic() < deadline:
+            line = await asyncio.wait_for(reader.readline(), max(0.1, deadline - time.monotonic()))
+            if not line:
+                errors.append("closed")
+                return
+            if line.startswith(b"data:"):
+                now = time.monotonic()
+                if last is not None:
+                    intervals.append(now - last)
+                last = now
+        writer.close()
+    except asyncio.TimeoutError:
+        pass
+    except OSError as e:
+        errors.append(type(e).__name__)
+
+
+def percentile(values, p):
+    if not values:
+        return float("nan")
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--host", default="192.168.0.1")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--path", default="/api/td")
+    parser.add_argument("--clients", type=int, default=4, help="concurrent HTTP clients")
+    parser.add_argument("--sse", type=int, default=2, help="concurrent /events listeners")
+    parser.add_argument("--duration", type=float, default=20, help="seconds")
+    parser.add_argument("--timeout", type=float, default=5, help="per request, seconds")
+    args = parser.parse_args()
+
+    latencies, intervals, errors = [], [], []
+    deadline = time.monotonic() + args.duration
+    tasks = [http_client(args, latencies, errors, deadline) for _ in range(args.clients)]
+    tasks += [sse_client(args, intervals, errors, deadline) for _ in range(args.sse)]
+    await asyncio.gather(*tasks)
+
+    print("HTTP %s: %d requests, %.1f req/s, %d errors" % (args.path, len(latencies), len(latencies) / args.duration, len(errors)))
+    print("  latency p50 %.1f ms, p99 %.1f ms" % (percentile(latencies, 50) * 1000, percentile(latencies, 99) * 1000))
+    if args.sse:
+        print("SSE: %d events, interval p50 %.1f ms, p99 %.1f ms" % (
+            len(intervals), percentile(intervals, 50) * 1000, percentile(intervals, 99) * 1000))
+
+
+if __name__ == "__main__":
+    asyncio.run(main())
@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+"""Reads the binary sample stream from the Td-Free USB serial port.
+
+Starts the stream, checks every frame's CRC and prints one line per sample,
+or CSV with --csv. Needs pyserial.
+
+    python3 scripts/serial_stream.py /dev/ttyACM0 --csv > trace.csv
+"""
+import argparse
+import struct
+import sys
+
+SYNC = b"\xa5\x5a"
+FRAME_SIZE = 28
+STATES = ["idle", "inserted", "settling", "latched"]
+
+
+def crc16_ccitt(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def frames(port):
+    buffer = b""
+    while True:
+        buffer += port.read(max(1, port.in_waiting))
+        while True:
+            start = buffer.find(SYNC)
+            if start < 0:
+                buffer = buffer[-1:]
+                break
+            if len(buffer) - start < FRAME_SIZE:
+                buffer = buffer[start:]
+                break
+            frame = buffer[start:start + FRAME_SIZE]
+            (crc,) = struct.unpack_from("<H", frame, 26)
+            if crc16_ccitt(frame[2:26]) != crc:
+                # Not a frame after all, look for the next sync
+                buffer = buffer[start + 1:]
+                continue
+            buffer = buffer[start + FRAME_SIZE:]
+            yield struct.unpack_from("<IIfffBB", frame, 4)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("port")
+    parser.add_argument("--csv", action="store_true")
+    args = parser.parse_args()
+
+    import serial
+
+    with serial.Serial(args.port, 921600, timeout=1) as port:
+        port.write(b"S")
+        if args.csv:
+            print("seq,timestamp_ms,channel,lux,transmission,td,state,stable")
+        last_seq = None
+        try:
+            for seq, timestamp_ms, lux, transmission, td, state, flags in frames(port):
+                if last_seq is not None and seq != last_seq + 1:
+                    print("# %d samples missed" % (seq - last_seq - 1), file=sys.stderr)
+                last_seq = seq
+                state = STATES[state] if state < len(STATES) else str(state)
+                if args.csv:
+                    print("%d,%d,%d,%.4f,%.3f,%.3f,%s,%d" % (seq, timestamp_ms, flags >> 4, lux, transmission, td, state, flags & 1))
+                else:
+                    print("%8d %10d ms  #%d  %10.4f lx  %7.3f %%  TD %6.2f  %s" % (seq, timestamp_ms, flags >> 4, lux, transmission, td, state))
+        except KeyboardInterrupt:
+            pass
+        finally:
+            port.write(b"X")
+
+
+if __name__ == "__main__":
+    main()
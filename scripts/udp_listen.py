@@ -0,0 +1,44 @@
+#!/usr/bin/env python3
+"""Prints the UDP telemetry of a Td-Free device.
+
+Any number of these can run at once, the device sends every sample only once
+to the multicast group (or as broadcast with --broadcast).
+
+    python3 scripts/udp_listen.py
+"""
+import argparse
+import socket
+import struct
+
+from serial_stream import FRAME_SIZE, STATES, crc16_ccitt
+
+GROUP = "239.84.68.70"
+PORT = 4210
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--broadcast", action="store_true", help="device was built with TELEMETRY=2")
+    parser.add_argument("--port", type=int, default=PORT)
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind(("", args.port))
+    if not args.broadcast:
+        membership = struct.pack("4s4s", socket.inet_aton(GROUP), socket.inet_aton("0.0.0.0"))
+        sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, membership)
+
+    while True:
+        frame, sender = sock.recvfrom(64)
+        if len(frame) != FRAME_SIZE or frame[:2] != b"\xa5\x5a":
+            continue
+        if crc16_ccitt(frame[2:26]) != struct.unpack_from("<H", frame, 26)[0]:
+            continue
+        seq, timestamp_ms, lux, transmission, td, state, flags = struct.unpack_from("<IIfffBB", frame, 4)
+        state = STATES[state] if state < len(STATES) else str(state)
+        print("%s %8d %10d ms  #%d  %10.4f lx  %7.3f %%  TD %6.2f  %s" % (sender[0], seq, timestamp_ms, flags >> 4, lux, transmission, td, state))
+
+
+if __name__ == "__main__":
+    main()
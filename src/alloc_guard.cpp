@@ -0,0 +1,69 @@
+#ifdef TDFREE_ALLOC_GUARD
+
+#include <atomic>
+#include <stdlib.h>
+#include <esp_rom_sys.h>
+#include "alloc_guard.h"
+
+extern "C" void *__real_malloc(size_t size);
+extern "C" void *__real_calloc(size_t count, size_t size);
+extern "C" void *__real_realloc(void *ptr, size_t size);
+
+std::atomic<bool> alloc_guard_armed(false);
+std::atomic<uint32_t> allocations(0);
+// Open NoAllocScopes of the current task
+__thread uint8_t no_alloc_depth;
+
+void noteAllocation(size_t size)
+{
+  if (!alloc_guard_armed.load(std::memory_order_relaxed))
+  {
+    return;
+  }
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (no_alloc_depth > 0)
+  {
+    esp_rom_printf("heap allocation of %u bytes inside a NoAllocScope\n", (unsigned)size);
+    abort();
+  }
+}
+
+extern "C" void *__wrap_malloc(size_t size)
+{
+  noteAllocation(size);
+  return __real_malloc(size);
+}
+
+extern "C" void *__wrap_calloc(size_t count, size_t size)
+{
+  noteAllocation(count * size);
+  return __real_calloc(count, size);
+}
+
+extern "C" void *__wrap_realloc(void *ptr, size_t size)
+{
+  noteAllocation(size);
+  return __real_realloc(ptr, size);
+}
+
+void armAllocGuard()
+{
+  alloc_guard_armed = true;
+}
+
+uint32_t allocationsAfterSetup()
+{
+  return allocations.load(std::memory_order_relaxed);
+}
+
+NoAllocScope::NoAllocScope()
+{
+  no_alloc_depth++;
+}
+
+NoAllocScope::~NoAllocScope()
+{
+  no_alloc_depth--;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#include "captive_dns.h"
+
+#define DNS_HEADER_SIZE 12
+#define DNS_MAX_PACKET 512
+#define DNS_ANSWER_SIZE 16
+#define DNS_TYPE_A 1
+#define DNS_TYPE_ANY 255
+#define DNS_TTL_S 60
+
+bool CaptiveDns::begin(IPAddress address, uint16_t port)
+{
+  this->address = address;
+  if (!udp.listen(port))
+  {
+    return false;
+  }
+  udp.onPacket([this](AsyncUDPPacket &packet)
+  {
+    handle(packet);
+  });
+  return true;
+}
+
+void CaptiveDns::handle(AsyncUDPPacket &packet)
+{
+  const uint8_t *query = packet.data();
+  size_t len = packet.length();
+  // Only standard queries (QR = 0, opcode = 0) with at least one question
+  if (len < DNS_HEADER_SIZE || (query[2] & 0xF8) != 0 || (query[4] == 0 && query[5] == 0))
+  {
+    return;
+  }
+
+  // Skip over the name of the first question, the rest of the packet is dropped
+  size_t pos = DNS_HEADER_SIZE;
+  while (pos < len && query[pos] != 0)
+  {
+    if (query[pos] & 0xC0)
+    {
+      // Compression pointers don't appear in a question
+      return;
+    }
+    pos += query[pos] + 1;
+  }
+  pos += 1 + 4; // terminating zero, type and class
+  if (pos > len || pos + DNS_ANSWER_SIZE > DNS_MAX_PACKET)
+  {
+    return;
+  }
+  uint16_t type = (query[pos - 4] << 8) | query[pos - 3];
+  bool answer = type == DNS_TYPE_A || type == DNS_TYPE_ANY;
+
+  uint8_t reply[DNS_MAX_PACKET];
+  memcpy(reply, query, pos);
+  reply[2] = 0x80 | (query[2] & 0x01); // response, keep the recursion desired bit
+  reply[3] = 0x80;                     // recursion available, no error
+  reply[4] = 0;
+  reply[5] = 1;
+  reply[6] = 0;
+  reply[7] = answer ? 1 : 0;
+  memset(reply + 8, 0, 4); // no authority or additional records
+  if (answer)
+  {
+    const uint8_t record[DNS_ANSWER_SIZE] = {
+        0xC0, DNS_HEADER_SIZE, // name: pointer to the question
+        0, DNS_TYPE_A,
+        0, 1, // class IN
+        0, 0, 0, DNS_TTL_S,
+        0, 4,
+        address[0], address[1], address[2], address[3],
+    };
+    memcpy(reply + pos, record, DNS_ANSWER_SIZE);
+    pos += DNS_ANSWER_SIZE;
+  }
+  packet.write(reply, pos);
+  queries.fetch_add(1, std::memory_order_relaxed);
+}
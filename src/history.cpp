@@ -0,0 +1,157 @@
+#include <Arduino.h>
+#include "history.h"
+
+SampleRing<Measurement, HISTORY_SIZE> history;
+
+// Only held for copying the label, never on the sampling path
+portMUX_TYPE label_lock = portMUX_INITIALIZER_UNLOCKED;
+char pending_label[SENSOR_CHANNELS][LABEL_SIZE];
+
+// Session state, also under label_lock
+#define SESSION_PREFIX_SIZE 16
+bool session_active;
+uint32_t session_first_seq;
+uint32_t session_end_seq;
+uint32_t session_number;
+char session_prefix[SESSION_PREFIX_SIZE];
+char session_queue[SESSION_QUEUE_SIZE][LABEL_SIZE];
+uint32_t session_queue_next;
+uint32_t session_queue_len;
+
+// Copies up to len characters of label, without control characters and cut to LABEL_SIZE
+void cleanLabel(char *clean, const char *label, size_t len)
+{
+  size_t n = 0;
+  for (size_t i = 0; i < len && label[i] && n < LABEL_SIZE - 1; i++)
+  {
+    // Control characters would only break the CSV/JSON export
+    if ((uint8_t)label[i] >= 0x20)
+    {
+      clean[n++] = label[i];
+    }
+  }
+  clean[n] = 0;
+}
+
+void setPendingLabel(uint8_t channel, const char *label)
+{
+  char clean[LABEL_SIZE];
+  cleanLabel(clean, label, strlen(label));
+
+  portENTER_CRITICAL(&label_lock);
+  memcpy(pending_label[channel], clean, LABEL_SIZE);
+  portEXIT_CRITICAL(&label_lock);
+}
+
+void recordMeasurement(uint8_t channel, uint32_t timestamp_ms, float transmission, float ci, float td, float lux, float baseline)
+{
+  Measurement m;
+  m.seq = history.count();
+  m.timestamp_ms = timestamp_ms;
+  m.channel = channel;
+  m.transmission = transmission;
+  m.ci = ci;
+  m.td = td;
+  m.lux = lux;
+  m.baseline = baseline;
+
+  bool numbered = false;
+  uint32_t number = 0;
+  char prefix[SESSION_PREFIX_SIZE];
+  portENTER_CRITICAL(&label_lock);
+  memcpy(m.label, pending_label[channel], LABEL_SIZE);
+  pending_label[channel][0] = 0;
+  if (session_active)
+  {
+    number = ++session_number;
+    session_end_seq = m.seq + 1;
+    if (m.label[0] == 0 && session_queue_next < session_queue_len)
+    {
+      memcpy(m.label, session_queue[session_queue_next++], LABEL_SIZE);
+    }
+    else if (m.label[0] == 0)
+    {
+      numbered = true;
+      memcpy(prefix, session_prefix, sizeof(prefix));
+    }
+  }
+  portEXIT_CRITICAL(&label_lock);
+  // Formatting stays outside the lock
+  if (numbered)
+  {
+    snprintf(m.label, LABEL_SIZE, "%s %u", prefix, (unsigned)number);
+  }
+
+  history.push(m);
+}
+
+// Only called from the web side
+bool startSession(const char *labels, const char *prefix)
+{
+  // The sensor task leaves the queue alone while no session runs, so it can be filled in place
+  endSession();
+  uint32_t count = 0;
+  const char *start = labels;
+  for (const char *p = labels;; p++)
+  {
+    if (*p == '\n' || *p == ',' || *p == 0)
+    {
+      // Surrounding blanks (and the \r of CRLF lists) don't belong to the label
+      const char *end = p;
+      while (start < end && (*start == ' ' || *start == '\r'))
+      {
+        start++;
+      }
+      while (end > start && (end[-1] == ' ' || end[-1] == '\r'))
+      {
+        end--;
+      }
+      if (end > start)
+      {
+        if (count == SESSION_QUEUE_SIZE)
+        {
+          return false;
+        }
+        cleanLabel(session_queue[count++], start, end - start);
+      }
+      start = p + 1;
+    }
+    if (*p == 0)
+    {
+      break;
+    }
+  }
+
+  char clean_prefix[LABEL_SIZE];
+  cleanLabel(clean_prefix, prefix, SESSION_PREFIX_SIZE - 1);
+
+  portENTER_CRITICAL(&label_lock);
+  session_queue_len = count;
+  session_queue_next = 0;
+  session_number = 0;
+  memcpy(session_prefix, clean_prefix, sizeof(session_prefix));
+  session_first_seq = history.count();
+  session_end_seq = session_first_seq;
+  session_active = true;
+  portEXIT_CRITICAL(&label_lock);
+  return true;
+}
+
+void endSession()
+{
+  portENTER_CRITICAL(&label_lock);
+  session_active = false;
+  portEXIT_CRITICAL(&label_lock);
+}
+
+SessionInfo sessionInfo()
+{
+  SessionInfo info;
+  portENTER_CRITICAL(&label_lock);
+  info.active = session_active;
+  info.first_seq = session_first_seq;
+  info.end_seq = session_end_seq;
+  info.queued = session_queue_len - session_queue_next;
+  portEXIT_CRITICAL(&label_lock);
+  return info;
+}
@@ -0,0 +1,29 @@
+#include <Arduino.h>
+#include <Wire.h>
+#include "i2c_mux.h"
+#include "veml_sensor.h"
+
+bool I2cMux::begin()
+{
+  Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN, I2C_FREQUENCY);
+  selected = NO_CHANNEL;
+  Wire.beginTransmission(I2C_MUX_ADDRESS);
+  return Wire.endTransmission() == 0;
+}
+
+bool I2cMux::select(uint8_t channel)
+{
+  if (channel == selected)
+  {
+    return true;
+  }
+  Wire.beginTransmission(I2C_MUX_ADDRESS);
+  Wire.write((uint8_t)(1 << channel));
+  if (Wire.endTransmission() != 0)
+  {
+    selected = NO_CHANNEL;
+    return false;
+  }
+  selected = channel;
+  return true;
+}
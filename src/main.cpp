@@ -1,132 +1,579 @@
-#include "Adafruit_VEML7700.h"
 #include "SPI.h"
 #include <Wire.h>
 #include <Arduino.h>
-#include <WiFi.h>
-#include <DNSServer.h>
-#include <WebServer.h>
-// put function declarations here:
-Adafruit_VEML7700 veml = Adafruit_VEML7700();
-extern const uint8_t index_html_start[] asm("_binary_src_html_index_html_start");
-extern const uint8_t index_html_end[] asm("_binary_src_html_index_html_end");
+#include <Preferences.h>
+#include <stddef.h>
+#include "alloc_guard.h"
+#include "auto_range.h"
+#include "baseline_tracker.h"
+#include "board.h"
+#include "filament_detector.h"
+#include "history.h"
+#include "light_sensor.h"
+#include "measurement.h"
+#include "metrics.h"
+#include "per_channel.h"
+#include "power.h"
+#include "sample_clock.h"
+#include "serial_stream.h"
+#include "spectral_correction.h"
+#include "td_curve.h"
+#include "telemetry.h"
+#include "td_filter.h"
+#include "transmission.h"
+#include "web.h"
+// The sensor type is fixed per build, the sampling path calls it without any indirection
+#ifdef TDFREE_SIMULATED_SENSOR
+#include "simulated_sensor.h"
+// How long each point of the recorded trace lasts
+#ifndef SIM_STEP_MS
+#define SIM_STEP_MS 100
+#endif
+PerChannel<SimulatedSensor, SENSOR_CHANNELS> sensor_impl(recorded_trace, recorded_trace_length, SIM_STEP_MS);
+typedef SimulatedSensor ChannelSensor;
+#else
+#include "veml_sensor.h"
+VemlSensor sensor_impl[SENSOR_CHANNELS];
+#if SENSOR_CHANNELS > 1
+#include "i2c_mux.h"
+I2cMux mux;
+MuxedSensor<VemlSensor> muxed_sensor[SENSOR_CHANNELS];
+typedef MuxedSensor<VemlSensor> ChannelSensor;
+#else
+typedef VemlSensor ChannelSensor;
+#endif
+#endif
 
-DNSServer dnsServer;
-WebServer server(80);
+// Calibration survives reboots in NVS, POST /api/calibrate takes a new one
+#define CALIBRATION_SAMPLES 20
+Preferences prefs;
+std::atomic<bool> calibrate_requested(false);
 
-float baseline_reading;
-IPAddress apIP(192, 168, 0, 1);
-IPAddress netMsk(255, 255, 255, 0);
-float final_td;
+// While nothing is inserted the baseline keeps following the empty-tube reading.
+// At the idle rate a weight of 0.01 is a time constant of about a minute.
+#define BASELINE_WEIGHT 0.01
+#define BASELINE_MAX_STEP 0.02
+#define BASELINE_HOLDOFF 4
+// Drift is written back to NVS now and then, not on every sample
+#define BASELINE_SAVE_INTERVAL_MS (30 * 60 * 1000UL)
+#define BASELINE_SAVE_CHANGE 0.01
 
-void replaceTemplateWithData(uint8_t *html, size_t htmlSize, const char *templateTag, float replacement)
+struct StoredCalibration
 {
-  // Convert the binary data to a String
-  String htmlString;
-  for (size_t i = 0; i < htmlSize && html[i] != 0; i++)
+  float baseline;
+  uint8_t gain;             // VEML7700_GAIN_* the baseline was taken at
+  uint8_t integration_time; // VEML7700_IT_* the baseline was taken at
+  int32_t weight_q16;       // spectral k the baseline was taken with, absent in older records (k = 0)
+};
+
+// Pick gain and integration time per reading instead of using the library defaults
+#define ADAPTIVE_RANGE 1
+
+// Noise filter between the raw transmission and what gets published
+#define MEDIAN_WINDOW 5
+#define EMA_WINDOW 4
+// Filter output counts as stable when it moves less than this, in percent
+#define STABLE_BAND 0.3
+typedef TdFilter<MEDIAN_WINDOW, EMA_WINDOW> Filter;
+
+// Insertion detection, only a settling measurement is sampled at the full rate.
+// A measurement is done once its 95 % confidence interval is +-CI_TOLERANCE percent.
+#ifndef CI_TOLERANCE
+#define CI_TOLERANCE 0.2
+#endif
+FilamentDetector::Config detector_config = {
+    90,           // present_below
+    95,           // absent_above
+    2,            // resettle_band
+    2,            // debounce
+    100,          // settle_timeout
+    1,            // plateau_band
+    CI_TOLERANCE, // ci_tolerance
+    4,            // min_samples
+};
+
+// Pipeline state of every light tube, one array per field indexed by channel.
+// Only touched by the sensor task, baselines are published with every sample.
+ChannelSensor *channel_sensor[SENSOR_CHANNELS];
+bool channel_present[SENSOR_CHANNELS];
+AutoRange channel_range[SENSOR_CHANNELS];
+// Conversions to throw away after a range change, the one in flight used the old setting
+uint8_t channel_discard[SENSOR_CHANNELS];
+// Failed reads in a row, the channel is given up after SENSOR_MAX_FAILURES
+uint8_t channel_failures[SENSOR_CHANNELS];
+PerChannel<Filter, SENSOR_CHANNELS> channel_filter(STABLE_BAND);
+PerChannel<FilamentDetector, SENSOR_CHANNELS> channel_detector(detector_config);
+PerChannel<BaselineTracker, SENSOR_CHANNELS> channel_tracker(BASELINE_WEIGHT, BASELINE_MAX_STEP, BASELINE_HOLDOFF);
+float channel_baseline[SENSOR_CHANNELS];
+float channel_saved_baseline[SENSOR_CHANNELS];
+uint32_t channel_last_save_ms[SENSOR_CHANNELS];
+// k the baselines above were taken with. Sampling keeps using it until they are retaken.
+int32_t active_weight_q16;
+
+SampleRing<Sample, SAMPLE_RING_SIZE> samples;
+
+// Sampling runs in its own task so a slow I2C read never holds up the web side and vice versa.
+// Every published sample averages OVERSAMPLE reads, paced by sample_clock. Ticks follow the
+// integration time but are never shorter than the published period / OVERSAMPLE.
+//
+// All sensors integrate at the same time, each tick reads every channel back to back.
+// A scan costs the longest integration time plus a few I2C transfers per channel,
+// not the sum of all integration times.
+#ifndef SAMPLE_PERIOD_MS
+#define SAMPLE_PERIOD_MS 100
+#endif
+#ifndef IDLE_SAMPLE_PERIOD_MS
+#define IDLE_SAMPLE_PERIOD_MS 500
+#endif
+#ifndef OVERSAMPLE
+#define OVERSAMPLE 4
+#endif
+// Integration time of the library defaults, for when ADAPTIVE_RANGE is off
+#define DEFAULT_INTEGRATION_MS 100
+SampleClock sample_clock;
+#define SENSOR_TASK_STACK 4096
+#define SENSOR_TASK_PRIORITY 2
+// With two cores loop() runs on ARDUINO_RUNNING_CORE and sampling on the other one
+#define SENSOR_TASK_CORE (Board::CORES > 1 && ARDUINO_RUNNING_CORE == 0 ? 1 : 0)
+TaskHandle_t sensor_task;
+// How often a missing sensor is looked for again
+#define SENSOR_RETRY_MS 5000
+// A sensor that fails this many reads in a row counts as gone, a loose wire
+// must not be measured as an opaque filament
+#define SENSOR_MAX_FAILURES 5
+std::atomic<uint8_t> device_status(STATUS_CALIBRATING);
+
+uint32_t tickPeriod()
+{
+  bool fast = false;
+  uint32_t integration_ms = 0;
+  for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
   {
-    htmlString += char(html[i]);
+    if (!channel_present[ch])
+    {
+      continue;
+    }
+    fast = fast || channel_detector[ch].needsFastSampling();
+#if ADAPTIVE_RANGE
+    uint32_t channel_ms = channel_range[ch].current().integration_ms;
+#else
+    uint32_t channel_ms = DEFAULT_INTEGRATION_MS;
+#endif
+    integration_ms = channel_ms > integration_ms ? channel_ms : integration_ms;
   }
+  uint32_t period = (fast ? SAMPLE_PERIOD_MS : IDLE_SAMPLE_PERIOD_MS) / OVERSAMPLE;
+  return period > integration_ms ? period : integration_ms;
+}
 
-  // Find and replace the template
-  int pos = htmlString.indexOf(templateTag);
-  if (pos != -1)
+void applyRange(uint8_t ch)
+{
+  channel_sensor[ch]->setRange(channel_range[ch].current());
+  channel_discard[ch] = 1;
+}
+
+// Waits for the next tick of sample_clock, then reads every channel once.
+// Returns a bit per channel that got a usable reading in lux/raw.
+uint32_t scanChannels(float *lux, RawReading *raw)
+{
+  uint32_t missed = sample_clock.wait();
+  if (missed)
   {
-    // Convert the float to a string with 2 decimal places
-    char floatStr[10];                    // Adjust the size as needed
-    dtostrf(replacement, 4, 2, floatStr); // 4 is the minimum width, 2 is the number of digits after the decimal point
+    metrics.missed_ticks.fetch_add(missed, std::memory_order_relaxed);
+  }
+  uint32_t usable = 0;
+  bool range_changed = false;
+  for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+  {
+    if (!channel_present[ch])
+    {
+      continue;
+    }
+    uint32_t start = micros();
+#if ADAPTIVE_RANGE
+    bool ok = channel_sensor[ch]->read(raw[ch]);
+    metrics.sensor_read.observe(micros() - start);
+    if (!ok)
+    {
+      metrics.sensor_errors.fetch_add(1, std::memory_order_relaxed);
+      if (++channel_failures[ch] >= SENSOR_MAX_FAILURES)
+      {
+        // Stops being sampled, the web side reports it as no_sensor
+        channel_present[ch] = false;
+      }
+      continue;
+    }
+    channel_failures[ch] = 0;
+    if (channel_discard[ch] > 0)
+    {
+      channel_discard[ch]--;
+      continue;
+    }
+    // Range decisions go by the raw count, that's what saturates
+    lux[ch] = channel_range[ch].lux(spectralCorrect(raw[ch].als, raw[ch].white, active_weight_q16));
+    AutoRange::Step step = channel_range[ch].update(raw[ch].als);
+    if (step != AutoRange::KEEP)
+    {
+      applyRange(ch);
+      range_changed = true;
+    }
+    if (step == AutoRange::RETRY)
+    {
+      continue;
+    }
+#else
+    raw[ch].als = 0;
+    raw[ch].white = 0;
+    lux[ch] = channel_sensor[ch]->readLux();
+    metrics.sensor_read.observe(micros() - start);
+#endif
+    usable |= 1u << ch;
+  }
+  if (range_changed && tickPeriod() != sample_clock.period())
+  {
+    sample_clock.setPeriod(tickPeriod());
+  }
+  return usable;
+}
 
-    // Replace the template with the formatted float string
-    htmlString.replace(templateTag, floatStr);
+// Scans until every channel has count usable readings and averages them into lux.
+// raw gets the counts of the last reading of each channel.
+void readAveraged(uint16_t count, float *lux, RawReading *raw)
+{
+  float sum[SENSOR_CHANNELS] = {};
+  uint16_t reads[SENSOR_CHANNELS] = {};
+  for (;;)
+  {
+    float scan_lux[SENSOR_CHANNELS];
+    RawReading scan_raw[SENSOR_CHANNELS];
+    uint32_t usable = scanChannels(scan_lux, scan_raw);
+    bool done = true;
+    for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+    {
+      if (!channel_present[ch])
+      {
+        continue;
+      }
+      if ((usable & (1u << ch)) && reads[ch] < count)
+      {
+        sum[ch] += scan_lux[ch];
+        raw[ch] = scan_raw[ch];
+        reads[ch]++;
+      }
+      done = done && reads[ch] == count;
+    }
+    if (done)
+    {
+      break;
+    }
+  }
+  for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+  {
+    lux[ch] = sum[ch] / count;
+  }
+}
 
-    // Update the non-const array with the modified String
-    size_t newHtmlSize = htmlString.length();
-    uint8_t *modifiedHtml = new uint8_t[newHtmlSize + 1]; // +1 for null terminator
-    for (size_t i = 0; i < newHtmlSize; i++)
+// Channel 0 keeps the key of the single-sensor firmware
+void calibrationKey(uint8_t ch, char *key, size_t size)
+{
+  snprintf(key, size, ch == 0 ? "calibration" : "calibration%u", (unsigned)ch);
+}
+
+void saveCalibration(uint8_t ch)
+{
+  StoredCalibration stored;
+  stored.baseline = channel_baseline[ch];
+  stored.gain = channel_sensor[ch]->gain();
+  stored.integration_time = channel_sensor[ch]->integrationTime();
+  stored.weight_q16 = active_weight_q16;
+  char key[16];
+  calibrationKey(ch, key, sizeof(key));
+  prefs.putBytes(key, &stored, sizeof(stored));
+  channel_saved_baseline[ch] = channel_baseline[ch];
+  channel_last_save_ms[ch] = millis();
+}
+
+// Takes a new baseline for the channels in mask and stores it
+void calibrate(uint32_t mask)
+{
+  float lux[SENSOR_CHANNELS];
+  RawReading raw[SENSOR_CHANNELS];
+  // Scanning reads every channel anyway, doing them one at a time would only take longer
+  readAveraged(CALIBRATION_SAMPLES, lux, raw);
+  for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+  {
+    if (channel_present[ch] && (mask & (1u << ch)))
     {
-      modifiedHtml[i] = static_cast<uint8_t>(htmlString.charAt(i));
+      channel_baseline[ch] = lux[ch];
+      saveCalibration(ch);
+      channel_filter[ch].reset();
     }
-    modifiedHtml[newHtmlSize] = 0; // Null-terminate the modified array
+  }
+}
 
-    // Copy the modified content back to the original array
-    memcpy(html, modifiedHtml, newHtmlSize + 1);
+void trackBaseline(uint8_t ch, float lux)
+{
+  if (channel_detector[ch].state() != FilamentDetector::IDLE)
+  {
+    channel_tracker[ch].hold();
+    return;
+  }
+  channel_baseline[ch] = channel_tracker[ch].update(channel_baseline[ch], lux);
+  float change = channel_baseline[ch] / channel_saved_baseline[ch] - 1;
+  if (millis() - channel_last_save_ms[ch] > BASELINE_SAVE_INTERVAL_MS && (change > BASELINE_SAVE_CHANGE || change < -BASELINE_SAVE_CHANGE))
+  {
+    saveCalibration(ch);
+  }
+}
 
-    // Release the memory allocated for the modified array
-    delete[] modifiedHtml;
+bool loadCalibration(uint8_t ch)
+{
+  StoredCalibration stored;
+  char key[16];
+  calibrationKey(ch, key, sizeof(key));
+  size_t len = prefs.getBytes(key, &stored, sizeof(stored));
+  if (len == offsetof(StoredCalibration, weight_q16))
+  {
+    stored.weight_q16 = 0;
   }
+  else if (len != sizeof(stored))
+  {
+    return false;
+  }
+  // A baseline taken with another k doesn't compare to corrected readings
+  if (!(stored.baseline > 0) || stored.weight_q16 != active_weight_q16)
+  {
+    return false;
+  }
+#if ADAPTIVE_RANGE
+  // Readings are normalized to lux, so the baseline is valid on any setting.
+  // Starting on the one it was taken at saves the first few range steps.
+  for (size_t i = 0; i < AutoRange::SETTING_COUNT; i++)
+  {
+    const RangeSetting &setting = AutoRange::setting(i);
+    if (setting.gain == stored.gain && setting.integration_time == stored.integration_time)
+    {
+      channel_range[ch].select(i);
+      applyRange(ch);
+      break;
+    }
+  }
+#else
+  if (stored.gain != channel_sensor[ch]->gain() || stored.integration_time != channel_sensor[ch]->integrationTime())
+  {
+    return false;
+  }
+#endif
+  channel_baseline[ch] = stored.baseline;
+  channel_saved_baseline[ch] = stored.baseline;
+  channel_last_save_ms[ch] = millis();
+  return true;
 }
 
-void handleRoot()
+void attachSensors()
 {
-  size_t htmlSize = 0;
-  while (index_html_start[htmlSize] != 0)
+  for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
   {
-    htmlSize++;
+#if SENSOR_CHANNELS > 1 && !defined(TDFREE_SIMULATED_SENSOR)
+    muxed_sensor[ch].attach(mux, sensor_impl[ch], ch);
+    channel_sensor[ch] = &muxed_sensor[ch];
+#else
+    channel_sensor[ch] = &sensor_impl[ch];
+#endif
   }
+}
 
-  // Create a non-const array for modification
-  uint8_t *html = new uint8_t[htmlSize + 1]; // +1 for null terminator
-  memcpy(html, index_html_start, htmlSize + 1);
-  const char *templateTag = "{{value}}";
-  float data = final_td;
-  replaceTemplateWithData(html, htmlSize, templateTag, data);
-  server.send(200, "text/html", reinterpret_cast<const char *>(html));
-  delete[] html;
+// Sensor bring-up and the first calibration. Runs in the sensor task, so it
+// overlaps with setup() bringing up the soft-AP and the web server.
+// Channels that don't answer stay off, false if none did.
+bool startSensors()
+{
+#if SENSOR_CHANNELS > 1 && !defined(TDFREE_SIMULATED_SENSOR)
+  if (!mux.begin())
+  {
+    return false;
+  }
+#endif
+  bool any = false;
+  for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+  {
+    channel_present[ch] = channel_sensor[ch]->begin();
+    channel_failures[ch] = 0;
+    any = any || channel_present[ch];
+  }
+  if (!any)
+  {
+    return false;
+  }
+
+  prefs.begin("td-free");
+  active_weight_q16 = spectral_weight_q16.load(std::memory_order_relaxed);
+  uint32_t uncalibrated = 0;
+  for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+  {
+    if (channel_present[ch])
+    {
+#if ADAPTIVE_RANGE
+      applyRange(ch);
+#endif
+      if (!loadCalibration(ch))
+      {
+        uncalibrated |= 1u << ch;
+      }
+    }
+  }
+  sample_clock.begin(tickPeriod());
+  if (uncalibrated)
+  {
+    calibrate(uncalibrated);
+  }
+  return true;
+}
+
+bool anyPresent()
+{
+  for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+  {
+    if (channel_present[ch])
+    {
+      return true;
+    }
+  }
+  return false;
 }
 
-void handleNotFound()
+// Retries until a sensor answers. Degraded mode: the web side stays up and
+// reports it, instead of the device hanging.
+void waitForSensors()
 {
-  server.sendHeader("Location", "/");
-  server.send(302, "text/plain", "redirect to captive portal");
+  if (startSensors())
+  {
+    return;
+  }
+  Serial.println("Sensor not found");
+  device_status = STATUS_NO_SENSOR;
+  do
+  {
+    // Nothing is mapped meanwhile, curve changes don't have to wait for a sample
+    td_curve.acknowledge();
+    vTaskDelay(pdMS_TO_TICKS(SENSOR_RETRY_MS));
+  } while (!startSensors());
 }
 
-void setup(void)
+void sensorTask(void *arg)
 {
-  Serial.begin(9600);
-  Serial.println("Boot ok!");
+  attachSensors();
+  waitForSensors();
+  device_status = STATUS_READY;
 
-  WiFi.mode(WIFI_AP);
-  WiFi.softAPConfig(apIP, apIP, netMsk);
-  WiFi.softAP("Td-Free");
-  dnsServer.start(53, "*", apIP);
+  uint32_t seq = 0;
+  for (;;)
+  {
+    if (!anyPresent())
+    {
+      // Every sensor stopped answering, start over once one is back
+      device_status = STATUS_NO_SENSOR;
+      waitForSensors();
+      device_status = STATUS_READY;
+    }
 
-  // serve a simple root page
-  server.on("/", handleRoot);
+    // A new k makes every baseline stale, they are retaken with it
+    int32_t weight_q16 = spectral_weight_q16.load(std::memory_order_relaxed);
+    if (calibrate_requested.exchange(false) || weight_q16 != active_weight_q16)
+    {
+      device_status = STATUS_CALIBRATING;
+      active_weight_q16 = weight_q16;
+      calibrate(~0u);
+      device_status = STATUS_READY;
+    }
 
-  // serve portal page
+    // Runs for every scan and stays off the heap, NVS writes come after it
+    float lux[SENSOR_CHANNELS];
+    {
+      NoAllocScope no_alloc;
+      RawReading raw[SENSOR_CHANNELS];
+      readAveraged(OVERSAMPLE, lux, raw);
+      uint32_t now = millis();
+      for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+      {
+        if (!channel_present[ch])
+        {
+          continue;
+        }
+        Filter &filter = channel_filter[ch];
+        FilamentDetector &detector = channel_detector[ch];
+        Sample sample;
+        sample.seq = seq++;
+        sample.timestamp_ms = now;
+        sample.channel = ch;
+        sample.lux = lux[ch];
+        sample.als = raw[ch].als;
+        sample.white = raw[ch].white;
 
-  server.onNotFound(handleNotFound);
-  server.begin();
+        sample.transmission = transmissionPercent(lux[ch], channel_baseline[ch]);
+        FilamentDetector::State previous_state = detector.state();
+        sample.state = detector.update(sample.transmission, filter);
+        if (previous_state == FilamentDetector::IDLE && sample.state != FilamentDetector::IDLE)
+        {
+          // Filament went in, someone is about to look at the result
+          wakeUp();
+        }
+        sample.filtered = filter.value();
+        sample.stable = filter.stable();
+        sample.td = td_curve.map(sample.filtered);
+        sample.latched = detector.latched();
+        sample.confidence = detector.confidence();
+        sample.baseline = channel_baseline[ch];
+        samples.push(sample);
 
+        if (sample.state == FilamentDetector::LATCHED && previous_state != FilamentDetector::LATCHED)
+        {
+          recordMeasurement(ch, sample.timestamp_ms, sample.latched, sample.confidence, td_curve.map(sample.latched), sample.lux, sample.baseline);
+        }
+      }
+    }
+    for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+    {
+      if (channel_present[ch])
+      {
+        trackBaseline(ch, lux[ch]);
+      }
+    }
 
-  if (!veml.begin()) {
-    Serial.println("Sensor not found");
-    while (1);
-  }
+    // Done with the curve until the next scan
+    td_curve.acknowledge();
 
-  float max_reading = 0;
-  int sample_count = 10;
-  for (int i = 0; i < sample_count; i++) {
-    max_reading += veml.readLux();
-    delay(200);
+    // Switch between the fast and the idle rate
+    if (tickPeriod() != sample_clock.period())
+    {
+      sample_clock.setPeriod(tickPeriod());
+    }
   }
-  baseline_reading = max_reading / sample_count;
-  // Now we're ready to get readings!
 }
 
-void loop(void)
+void setup(void)
 {
-  Serial.println("LOOP");
+  setupSerialStream();
+  Serial.println("Boot ok!");
 
-  float current_lux = veml.readLux();
-  
-  // Calculate the transmission percentage
-  if (baseline_reading != 0) {
-    final_td = (current_lux / baseline_reading) * 100.0;
-  } else {
-    final_td = 0; // Avoid division by zero
-  }
+  loadStoredCurve();
+  loadStoredSpectralWeight();
+  // Calibrates in the background, the page is up before it's done and shows "calibrating"
+  xTaskCreatePinnedToCore(sensorTask, "sensor", SENSOR_TASK_STACK, NULL, SENSOR_TASK_PRIORITY, &sensor_task, SENSOR_TASK_CORE);
+
+  setupWeb();
+  setupTelemetry();
+  setupPower();
+  armAllocGuard();
+}
 
-  dnsServer.processNextRequest();
-  server.handleClient();
-  delay(100);
-}
\ No newline at end of file
+void loop(void)
+{
+  // HTTP and DNS are served from the AsyncTCP/AsyncUDP tasks, this only pushes new values.
+  // Sampling happens in sensorTask.
+  uint32_t start = micros();
+  loopWeb();
+  loopSerialStream();
+  loopTelemetry();
+  metrics.loop.observe(micros() - start);
+  powerWait();
+}
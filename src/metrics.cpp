@@ -0,0 +1,98 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_heap_caps.h>
+#include <stdarg.h>
+#include "alloc_guard.h"
+#include "measurement.h"
+#include "metrics.h"
+#include "power.h"
+#include "wifi_config.h"
+
+const uint32_t Histogram::BOUNDS_US[Histogram::BOUND_COUNT] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000,
+};
+
+Metrics metrics;
+
+// Print::printf() falls back to malloc() for anything longer than 64 bytes,
+// every HELP line is. This formats on the stack instead.
+void printTo(Print &out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void printTo(Print &out, const char *fmt, ...)
+{
+  char line[256];
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  if (n > 0)
+  {
+    out.write(reinterpret_cast<const uint8_t *>(line), (size_t)n < sizeof(line) ? n : sizeof(line) - 1);
+  }
+}
+
+void writeHistogram(Print &out, const char *name, const char *help, const char *labels, const Histogram &histogram, bool header)
+{
+  if (header)
+  {
+    printTo(out, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+  }
+  // Prometheus buckets are cumulative
+  const char *sep = labels[0] ? "," : "";
+  uint32_t total = 0;
+  for (size_t i = 0; i < Histogram::BOUND_COUNT; i++)
+  {
+    total += histogram.bucket(i);
+    printTo(out, "%s_bucket{%s%sle=\"%g\"} %u\n", name, labels, sep, Histogram::BOUNDS_US[i] / 1e6, (unsigned)total);
+  }
+  total += histogram.bucket(Histogram::BOUND_COUNT);
+  printTo(out, "%s_bucket{%s%sle=\"+Inf\"} %u\n", name, labels, sep, (unsigned)total);
+  const char *braced = labels[0] ? "{" : "";
+  const char *unbraced = labels[0] ? "}" : "";
+  printTo(out, "%s_sum%s%s%s %g\n", name, braced, labels, unbraced, histogram.sum() / 1e6);
+  printTo(out, "%s_count%s%s%s %u\n", name, braced, labels, unbraced, (unsigned)total);
+}
+
+void writeGauge(Print &out, const char *name, const char *help, const char *type, uint32_t value)
+{
+  printTo(out, "# HELP %s %s\n# TYPE %s %s\n%s %u\n", name, help, name, type, name, (unsigned)value);
+}
+
+void writeMetrics(Print &out)
+{
+  writeHistogram(out, "tdfree_loop_seconds", "Work done per loop() iteration.", "", metrics.loop, true);
+  writeHistogram(out, "tdfree_sensor_read_seconds", "Time taken by one lux reading.", "", metrics.sensor_read, true);
+  writeHistogram(out, "tdfree_http_handler_seconds", "HTTP handler service time.", "handler=\"root\"", metrics.http_root, true);
+  writeHistogram(out, "tdfree_http_handler_seconds", "", "handler=\"not_found\"", metrics.http_not_found, false);
+
+  writeGauge(out, "tdfree_sample_ticks_missed_total", "Sample clock ticks the sensor task was too slow for.", "counter",
+             metrics.missed_ticks.load(std::memory_order_relaxed));
+  writeGauge(out, "tdfree_stream_dropped_total", "Samples the serial stream could not keep up with.", "counter",
+             metrics.stream_dropped.load(std::memory_order_relaxed));
+  writeGauge(out, "tdfree_sensor_errors_total", "Sensor reads that failed on the I2C bus.", "counter",
+             metrics.sensor_errors.load(std::memory_order_relaxed));
+  writeGauge(out, "tdfree_dns_queries_total", "Captive portal DNS queries answered.", "counter", dnsQueries());
+  writeGauge(out, "tdfree_heap_free_bytes", "Free heap.", "gauge", ESP.getFreeHeap());
+  writeGauge(out, "tdfree_heap_min_free_bytes", "Lowest free heap since boot.", "gauge", ESP.getMinFreeHeap());
+  writeGauge(out, "tdfree_heap_largest_free_block_bytes", "Largest allocatable block, drops with fragmentation.", "gauge",
+             heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+#ifdef TDFREE_ALLOC_GUARD
+  writeGauge(out, "tdfree_heap_allocations_total", "Heap allocations since setup() finished.", "counter", allocationsAfterSetup());
+#endif
+  writeGauge(out, "tdfree_softap_stations", "Stations connected to the soft-AP.", "gauge", WiFi.softAPgetStationNum());
+  writeGauge(out, "tdfree_cpu_mhz", "CPU clock, lower while idle.", "gauge", cpuMhz());
+  writeGauge(out, "tdfree_uptime_seconds", "Time since boot.", "counter", millis() / 1000);
+
+  uint8_t status = device_status.load();
+  writeGauge(out, "tdfree_sensor_up", "Whether the light sensor answered.", "gauge", status != STATUS_NO_SENSOR);
+  writeGauge(out, "tdfree_calibrating", "Whether a baseline is being taken right now.", "gauge", status == STATUS_CALIBRATING);
+
+  printTo(out, "# HELP tdfree_baseline_lux Empty-tube reading, follows drift while idle.\n# TYPE tdfree_baseline_lux gauge\n");
+  for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+  {
+    Sample sample;
+    if (latestSample(ch, sample))
+    {
+      printTo(out, "tdfree_baseline_lux{channel=\"%u\"} %g\n", (unsigned)ch, sample.baseline);
+    }
+  }
+}
@@ -0,0 +1,127 @@
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <Preferences.h>
+#include <Update.h>
+#include <esp_system.h>
+#include "ota.h"
+#include "web.h"
+
+#ifndef OTA_PASSWORD
+// Lowercase and digits only, easy to type from the serial log. 12 of them are about 62 bits.
+#define ADMIN_PASSWORD_LENGTH 12
+char admin_password[ADMIN_PASSWORD_LENGTH + 1];
+#endif
+
+// Request whose upload currently goes into flash, only one at a time
+AsyncWebServerRequest *ota_request;
+bool ota_failed;
+
+const char *adminPassword()
+{
+#ifdef OTA_PASSWORD
+  return OTA_PASSWORD;
+#else
+  return admin_password;
+#endif
+}
+
+// Chunks arrive in order from the AsyncTCP task and go straight to flash,
+// Update hashes everything it writes, so the image is never held in RAM.
+void handleUpload(AsyncWebServerRequest *request, const String &filename, size_t index, uint8_t *data, size_t len, bool final)
+{
+  if (index == 0)
+  {
+    // Without the uploader's own digest there is nothing to check the image against
+    if (ota_request != NULL || !request->hasParam("md5") || !request->authenticate(OTA_USERNAME, adminPassword()))
+    {
+      return;
+    }
+    ota_request = request;
+    ota_failed = !Update.begin(UPDATE_SIZE_UNKNOWN, U_FLASH);
+    // The whole image is compared against it when the upload ends
+    if (!ota_failed)
+    {
+      ota_failed = !Update.setMD5(request->getParam("md5")->value().c_str());
+    }
+    // Drop the half-written slot if the client goes away
+    request->onDisconnect([request]()
+    {
+      if (ota_request == request)
+      {
+        Update.abort();
+        ota_request = NULL;
+      }
+    });
+  }
+  if (ota_request != request || ota_failed)
+  {
+    return;
+  }
+  if (Update.write(data, len) != len)
+  {
+    ota_failed = true;
+    Update.abort();
+    return;
+  }
+  if (final)
+  {
+    ota_failed = !Update.end(true);
+  }
+}
+
+void handleUpdate(AsyncWebServerRequest *request)
+{
+  if (!request->authenticate(OTA_USERNAME, adminPassword()))
+  {
+    request->requestAuthentication();
+    return;
+  }
+  if (!request->hasParam("md5"))
+  {
+    request->send(400, "text/plain", "missing md5");
+    return;
+  }
+  if (ota_request != request)
+  {
+    request->send(ota_request ? 409 : 400, "text/plain", ota_request ? "another update is running" : "no firmware");
+    return;
+  }
+  ota_request = NULL;
+  if (ota_failed || Update.hasError())
+  {
+    request->send(500, "text/plain", Update.hasError() ? Update.errorString() : "update failed");
+    return;
+  }
+  request->send(200, "text/plain", "ok, rebooting");
+  // Until then the sensor task keeps measuring as usual
+  restartSoon();
+}
+
+void loadAdminPassword()
+{
+#ifndef OTA_PASSWORD
+  Preferences admin_prefs;
+  admin_prefs.begin("td-admin");
+  admin_prefs.getString("password", admin_password, sizeof(admin_password));
+  if (strlen(admin_password) != ADMIN_PASSWORD_LENGTH)
+  {
+    // First boot. WiFi is up by now, which makes esp_random() a true random source.
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+    for (size_t i = 0; i < ADMIN_PASSWORD_LENGTH; i++)
+    {
+      admin_password[i] = alphabet[esp_random() % (sizeof(alphabet) - 1)];
+    }
+    admin_password[ADMIN_PASSWORD_LENGTH] = 0;
+    admin_prefs.putString("password", admin_password);
+  }
+  admin_prefs.end();
+  Serial.print("Admin password: ");
+  Serial.println(admin_password);
+#endif
+}
+
+void setupOta(AsyncWebServer &server)
+{
+  loadAdminPassword();
+  server.on("/update", HTTP_POST, handleUpdate, handleUpload);
+}
@@ -0,0 +1,98 @@
+#include <Arduino.h>
+#include <atomic>
+#include <WiFi.h>
+#include "power.h"
+#include "serial_stream.h"
+#include "web.h"
+#include "wifi_config.h"
+
+// 0 keeps the CPU at full speed and the modem awake all the time
+#ifndef POWER_SAVE
+#define POWER_SAVE 1
+#endif
+// Lowest clock WiFi still runs at. The APB bus stays at 80 MHz, so I2C and USB don't notice.
+#ifndef IDLE_CPU_MHZ
+#define IDLE_CPU_MHZ 80
+#endif
+// Idle once nothing asked for full speed for this long
+#define POWER_IDLE_AFTER_MS 10000
+#define BUSY_LOOP_MS 2
+// While idle loop() only publishes the slow idle samples, wakeUp() cuts the wait short
+#define IDLE_LOOP_MS 50
+
+TaskHandle_t loop_task;
+SemaphoreHandle_t power_mutex;
+uint32_t full_cpu_mhz;
+std::atomic<bool> power_idle(false);
+std::atomic<uint32_t> last_wake_ms(0);
+
+bool busy()
+{
+  return millis() - last_wake_ms < POWER_IDLE_AFTER_MS || serialStreaming() || eventSubscribers() > 0;
+}
+
+void setIdle(bool idle)
+{
+  xSemaphoreTake(power_mutex, portMAX_DELAY);
+  // A wakeUp() that came in since the caller looked wins
+  if (idle && busy())
+  {
+    idle = false;
+  }
+  if (power_idle != idle)
+  {
+    setCpuFrequencyMhz(idle ? IDLE_CPU_MHZ : full_cpu_mhz);
+    if (stationMode())
+    {
+      // Modem sleep holds incoming packets until the next beacon, off while someone is using the device
+      WiFi.setSleep(idle);
+    }
+    power_idle = idle;
+  }
+  xSemaphoreGive(power_mutex);
+}
+
+void setupPower()
+{
+  // setup() runs in the loop task
+  loop_task = xTaskGetCurrentTaskHandle();
+  power_mutex = xSemaphoreCreateMutex();
+  full_cpu_mhz = getCpuFrequencyMhz();
+  last_wake_ms = millis();
+  if (stationMode())
+  {
+    WiFi.setSleep(false);
+  }
+}
+
+void wakeUp()
+{
+  last_wake_ms = millis();
+  if (power_idle && power_mutex != NULL)
+  {
+    setIdle(false);
+    xTaskNotifyGive(loop_task);
+  }
+}
+
+void powerWait()
+{
+#if POWER_SAVE
+  bool idle = !busy();
+  if (idle != power_idle)
+  {
+    setIdle(idle);
+  }
+  if (idle)
+  {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(IDLE_LOOP_MS));
+    return;
+  }
+#endif
+  delay(BUSY_LOOP_MS);
+}
+
+uint32_t cpuMhz()
+{
+  return getCpuFrequencyMhz();
+}
@@ -0,0 +1,50 @@
+#include "sample_clock.h"
+
+bool SampleClock::begin(uint32_t period_ms)
+{
+  if (timer != NULL)
+  {
+    // Sensors came back after being lost, the timer is still there
+    setPeriod(period_ms);
+    return true;
+  }
+  esp_timer_create_args_t args = {};
+  args.callback = &SampleClock::onTick;
+  args.arg = this;
+  args.dispatch_method = ESP_TIMER_TASK;
+  args.name = "sample";
+  if (esp_timer_create(&args, &timer) != ESP_OK)
+  {
+    return false;
+  }
+  setPeriod(period_ms);
+  return true;
+}
+
+void SampleClock::setPeriod(uint32_t period_ms)
+{
+  esp_timer_stop(timer);
+  this->period_ms = period_ms;
+  // Ticks of the old period don't count anymore
+  ulTaskNotifyTake(pdTRUE, 0);
+  esp_timer_start_periodic(timer, (uint64_t)period_ms * 1000);
+}
+
+uint32_t SampleClock::wait()
+{
+  task.store(xTaskGetCurrentTaskHandle());
+  // The timeout only matters if the timer died, don't hang the sensor task then
+  uint32_t ticks = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(2 * period_ms + 100));
+  return ticks > 1 ? ticks - 1 : 0;
+}
+
+void SampleClock::onTick(void *arg)
+{
+  // Runs in the esp_timer task, so the plain notify is fine
+  SampleClock *clock = static_cast<SampleClock *>(arg);
+  TaskHandle_t task = clock->task.load();
+  if (task != NULL)
+  {
+    xTaskNotifyGive(task);
+  }
+}
@@ -0,0 +1,123 @@
+#include <Arduino.h>
+#include "alloc_guard.h"
+#include "board.h"
+#include "measurement.h"
+#include "metrics.h"
+#include "serial_stream.h"
+#include "stream_frame.h"
+
+#define SERIAL_BAUD 921600
+#define STREAM_START 'S'
+#define STREAM_STOP 'X'
+// Frames per buffer, the ring has room for SAMPLE_RING_SIZE samples anyway
+#define STREAM_BUFFER_FRAMES 16
+
+// Double buffered: frames are collected into one buffer while the other one
+// drains into the port, so encoding never waits for the host to read.
+uint8_t stream_buffers[2][STREAM_BUFFER_FRAMES * STREAM_FRAME_SIZE];
+uint8_t stream_fill_index;
+size_t stream_fill_len;
+size_t stream_drain_len;
+size_t stream_drain_off;
+
+bool streaming;
+uint32_t stream_next_seq;
+
+void setupSerialStream()
+{
+  if (!Board::USB_CDC)
+  {
+    // A UART only has its 128-byte FIFO, give it room for a whole buffer so frames never wait
+    Serial.setTxBufferSize(sizeof(stream_buffers[0]));
+  }
+  // Native USB CDC ignores the baud rate and runs at full USB speed
+  Serial.begin(SERIAL_BAUD);
+}
+
+void handleCommands()
+{
+  while (Serial.available() > 0)
+  {
+    int c = Serial.read();
+    if (c == STREAM_START && !streaming)
+    {
+      streaming = true;
+      // Start with the newest sample, not whatever is left in the ring
+      uint32_t n = samples.count();
+      stream_next_seq = n > 0 ? n - 1 : 0;
+      stream_fill_len = 0;
+      stream_drain_len = 0;
+      stream_drain_off = 0;
+    }
+    else if (c == STREAM_STOP)
+    {
+      streaming = false;
+    }
+  }
+}
+
+void collectFrames()
+{
+  uint8_t *buffer = stream_buffers[stream_fill_index];
+  uint32_t n = samples.count();
+  if (n - stream_next_seq > SAMPLE_RING_SIZE)
+  {
+    // Fell behind by more than the ring holds, skip what is gone already
+    metrics.stream_dropped.fetch_add(n - SAMPLE_RING_SIZE - stream_next_seq, std::memory_order_relaxed);
+    stream_next_seq = n - SAMPLE_RING_SIZE;
+  }
+  while (stream_next_seq < n && stream_fill_len + STREAM_FRAME_SIZE <= sizeof(stream_buffers[0]))
+  {
+    Sample sample;
+    if (samples.read(stream_next_seq++, sample))
+    {
+      encodeStreamFrame(buffer + stream_fill_len, sample);
+      stream_fill_len += STREAM_FRAME_SIZE;
+    }
+    else
+    {
+      metrics.stream_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+void drainFrames()
+{
+  if (stream_drain_off == stream_drain_len && stream_fill_len > 0)
+  {
+    // Swap buffers, the filled one drains while the other one fills up
+    stream_drain_len = stream_fill_len;
+    stream_drain_off = 0;
+    stream_fill_index ^= 1;
+    stream_fill_len = 0;
+  }
+  size_t remaining = stream_drain_len - stream_drain_off;
+  if (remaining == 0)
+  {
+    return;
+  }
+  int room = Serial.availableForWrite();
+  if (room <= 0)
+  {
+    return;
+  }
+  size_t n = remaining < (size_t)room ? remaining : (size_t)room;
+  stream_drain_off += Serial.write(stream_buffers[stream_fill_index ^ 1] + stream_drain_off, n);
+}
+
+bool serialStreaming()
+{
+  return streaming;
+}
+
+void loopSerialStream()
+{
+  NoAllocScope no_alloc;
+  handleCommands();
+  if (!streaming)
+  {
+    return;
+  }
+  collectFrames();
+  drainFrames();
+}
@@ -0,0 +1,89 @@
+#include <Arduino.h>
+#include "simulated_sensor.h"
+
+#define SIM_NOISE_PERCENT 0.3f
+// Roughly what a 4000K LED gives
+#define SIM_WHITE_RATIO 1.6f
+
+const float recorded_trace[] = {
+    // empty tube
+    1502, 1498, 1501, 1503, 1499, 1500, 1502, 1497, 1501, 1500,
+    1499, 1502, 1500, 1498, 1501, 1503, 1500, 1499, 1501, 1500,
+    // translucent PLA going in
+    1320, 980, 610, 452, 431, 428, 426, 427, 425, 426,
+    426, 425, 427, 426, 425, 426, 426, 427, 425, 426,
+    426, 425, 426, 427, 426, 425, 426, 426, 425, 426,
+    // pulled out again
+    890, 1420, 1496, 1500, 1501, 1499, 1500, 1502, 1500, 1499,
+    1501, 1500, 1498, 1500, 1501, 1500, 1499, 1500, 1502, 1500,
+    // nearly opaque black filament
+    1105, 402, 61, 9.6, 4.1, 3.2, 3.0, 2.9, 2.9, 3.0,
+    2.9, 2.9, 3.0, 2.9, 2.9, 3.0, 2.9, 2.8, 2.9, 2.9,
+    2.9, 3.0, 2.9, 2.9, 2.9, 3.0, 2.9, 2.9, 2.9, 2.9,
+    // out again
+    610, 1380, 1497, 1501, 1500, 1499, 1500, 1501, 1500, 1500,
+    1499, 1501, 1500, 1502, 1500, 1499, 1500, 1501, 1500, 1500,
+    // wobbly white PETG, takes a while to settle
+    1290, 920, 188, 176, 193, 181, 170, 185, 178, 180,
+    176, 182, 179, 177, 181, 180, 178, 179, 180, 179,
+    180, 179, 178, 180, 179, 180, 179, 179, 180, 179,
+    // and out
+    790, 1450, 1499, 1500, 1502, 1500, 1499, 1501, 1500, 1500,
+};
+const size_t recorded_trace_length = sizeof(recorded_trace) / sizeof(recorded_trace[0]);
+
+SimulatedSensor::SimulatedSensor(const float *trace, size_t length, uint32_t step_ms)
+    : trace(trace), length(length), step_ms(step_ms), start_ms(0), noise(2463534242u), range(AutoRange::setting(0))
+{
+}
+
+bool SimulatedSensor::begin()
+{
+  start_ms = millis();
+  return true;
+}
+
+void SimulatedSensor::setRange(const RangeSetting &setting)
+{
+  range = setting;
+}
+
+uint8_t SimulatedSensor::gain()
+{
+  return range.gain;
+}
+
+uint8_t SimulatedSensor::integrationTime()
+{
+  return range.integration_time;
+}
+
+uint16_t toCount(float count)
+{
+  return count > 65535 ? 65535 : (uint16_t)count;
+}
+
+bool SimulatedSensor::read(RawReading &reading)
+{
+  float count = currentLux() / AutoRange::resolution(range);
+  reading.als = toCount(count);
+  reading.white = toCount(count * SIM_WHITE_RATIO);
+  return true;
+}
+
+float SimulatedSensor::readLux()
+{
+  delay(100);
+  return currentLux();
+}
+
+float SimulatedSensor::currentLux()
+{
+  // xorshift32, deterministic so runs are comparable
+  noise ^= noise << 13;
+  noise ^= noise >> 17;
+  noise ^= noise << 5;
+  float jitter = ((noise % 2001) / 1000.0f - 1.0f) * SIM_NOISE_PERCENT / 100.0f;
+  size_t i = ((millis() - start_ms) / step_ms) % length;
+  return trace[i] * (1.0f + jitter);
+}
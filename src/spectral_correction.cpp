@@ -0,0 +1,41 @@
+#include <Arduino.h>
+#include <Preferences.h>
+#include <math.h>
+#include "spectral_correction.h"
+
+std::atomic<int32_t> spectral_weight_q16(spectralWeightQ16(SPECTRAL_WEIGHT));
+
+// Own handle, this is called from the web side while the sensor task uses its own
+Preferences spectral_prefs;
+
+void loadStoredSpectralWeight()
+{
+  spectral_prefs.begin("td-spectral");
+  spectral_weight_q16.store(spectral_prefs.getInt("weight", spectralWeightQ16(SPECTRAL_WEIGHT)), std::memory_order_relaxed);
+  spectral_prefs.end();
+}
+
+bool setSpectralWeight(const char *weight)
+{
+  char *end;
+  float k = strtof(weight, &end);
+  if (end == weight || *end != 0 || !isfinite(k) || fabsf(k) > SPECTRAL_WEIGHT_MAX)
+  {
+    return false;
+  }
+  int32_t q16 = spectralWeightQ16(k);
+  spectral_weight_q16.store(q16, std::memory_order_relaxed);
+
+  spectral_prefs.begin("td-spectral");
+  spectral_prefs.putInt("weight", q16);
+  spectral_prefs.end();
+  return true;
+}
+
+void clearSpectralWeight()
+{
+  spectral_weight_q16.store(spectralWeightQ16(SPECTRAL_WEIGHT), std::memory_order_relaxed);
+  spectral_prefs.begin("td-spectral");
+  spectral_prefs.remove("weight");
+  spectral_prefs.end();
+}
@@ -0,0 +1,67 @@
+#include <Arduino.h>
+#include <Preferences.h>
+#include "td_curve.h"
+
+constexpr float TdCurve::DEFAULT_CURVE[TD_CURVE_POINTS];
+
+TdCurve td_curve;
+
+// Own handle, this is called from the web side while the sensor task uses its own
+Preferences curve_prefs;
+
+void loadStoredCurve()
+{
+  float table[TD_CURVE_POINTS];
+  curve_prefs.begin("td-curve");
+  if (curve_prefs.getBytes("table", table, sizeof(table)) == sizeof(table))
+  {
+    td_curve.loadTable(table);
+  }
+  curve_prefs.end();
+}
+
+bool setUserCurve(const char *points)
+{
+  float transmission[TD_CURVE_MAX_INPUT];
+  float td[TD_CURVE_MAX_INPUT];
+  size_t count = 0;
+  const char *p = points;
+  while (*p)
+  {
+    char *end;
+    if (count == TD_CURVE_MAX_INPUT)
+    {
+      return false;
+    }
+    transmission[count] = strtof(p, &end);
+    if (end == p || *end != ':')
+    {
+      return false;
+    }
+    p = end + 1;
+    td[count] = strtof(p, &end);
+    if (end == p || (*end != ',' && *end != 0))
+    {
+      return false;
+    }
+    count++;
+    p = *end ? end + 1 : end;
+  }
+  if (!td_curve.load(transmission, td, count))
+  {
+    return false;
+  }
+
+  curve_prefs.begin("td-curve");
+  curve_prefs.putBytes("table", td_curve.table(), TD_CURVE_POINTS * sizeof(float));
+  curve_prefs.end();
+  return true;
+}
+
+void clearUserCurve()
+{
+  td_curve.reset();
+  curve_prefs.begin("td-curve");
+  curve_prefs.remove("table");
+  curve_prefs.end();
+}
@@ -0,0 +1,72 @@
+#include <Arduino.h>
+#include <AsyncUDP.h>
+#include <Preferences.h>
+#include <WiFi.h>
+#include <atomic>
+#include "measurement.h"
+#include "stream_frame.h"
+#include "telemetry.h"
+#include "wifi_config.h"
+
+// 0 turns the publisher off, 1 sends to TELEMETRY_GROUP, 2 broadcasts
+#ifndef TELEMETRY
+#define TELEMETRY 1
+#endif
+#define TELEMETRY_PORT 4210
+IPAddress telemetry_group(239, 84, 68, 70);
+
+AsyncUDP telemetry_udp;
+uint32_t telemetry_next_seq;
+std::atomic<bool> telemetry_enabled(false);
+
+void setupTelemetry()
+{
+  Preferences telemetry_prefs;
+  telemetry_prefs.begin("td-telemetry");
+  // On the hotspot only its own clients hear it, a shared network gets it once asked for
+  telemetry_enabled = telemetry_prefs.getBool("enabled", !stationMode());
+  telemetry_prefs.end();
+  telemetry_next_seq = samples.count();
+}
+
+void setTelemetryEnabled(bool enabled)
+{
+  telemetry_enabled = enabled;
+  Preferences telemetry_prefs;
+  telemetry_prefs.begin("td-telemetry");
+  telemetry_prefs.putBool("enabled", enabled);
+  telemetry_prefs.end();
+}
+
+void loopTelemetry()
+{
+#if TELEMETRY
+  uint32_t n = samples.count();
+  if (!telemetry_enabled || (!stationMode() && WiFi.softAPgetStationNum() == 0))
+  {
+    // Off or nobody on the hotspot to listen, and a late listener only cares about new samples anyway
+    telemetry_next_seq = n;
+    return;
+  }
+  if (n - telemetry_next_seq > SAMPLE_RING_SIZE)
+  {
+    telemetry_next_seq = n - SAMPLE_RING_SIZE;
+  }
+  while (telemetry_next_seq < n)
+  {
+    Sample sample;
+    if (!samples.read(telemetry_next_seq++, sample))
+    {
+      continue;
+    }
+    uint8_t frame[STREAM_FRAME_SIZE];
+    encodeStreamFrame(frame, sample);
+    tcpip_adapter_if_t interface = stationMode() ? TCPIP_ADAPTER_IF_STA : TCPIP_ADAPTER_IF_AP;
+#if TELEMETRY == 2
+    telemetry_udp.broadcastTo(frame, sizeof(frame), TELEMETRY_PORT, interface);
+#else
+    telemetry_udp.writeTo(frame, sizeof(frame), telemetry_group, TELEMETRY_PORT, interface);
+#endif
+  }
+#endif
+}
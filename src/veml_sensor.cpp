@@ -0,0 +1,63 @@
+#include <Arduino.h>
+#include <Wire.h>
+#include "veml_sensor.h"
+
+#define VEML7700_ADDRESS 0x10
+#define VEML7700_REG_ALS 0x04
+#define VEML7700_REG_WHITE 0x05
+
+bool VemlSensor::begin()
+{
+  Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN, I2C_FREQUENCY);
+  if (!veml.begin(&Wire))
+  {
+    return false;
+  }
+  // In case the library restarted the bus with its own settings
+  Wire.setClock(I2C_FREQUENCY);
+  return true;
+}
+
+void VemlSensor::setRange(const RangeSetting &setting)
+{
+  veml.setGain(setting.gain);
+  veml.setIntegrationTime(setting.integration_time, false);
+}
+
+uint8_t VemlSensor::gain()
+{
+  return veml.getGain();
+}
+
+uint8_t VemlSensor::integrationTime()
+{
+  return veml.getIntegrationTime();
+}
+
+// A missing ACK must not pass for a dark reading, so every step is checked
+bool VemlSensor::readRegister(uint8_t reg, uint16_t &value)
+{
+  Wire.beginTransmission(VEML7700_ADDRESS);
+  Wire.write(reg);
+  if (Wire.endTransmission(false) != 0)
+  {
+    return false;
+  }
+  if (Wire.requestFrom((uint8_t)VEML7700_ADDRESS, (uint8_t)2) != 2)
+  {
+    return false;
+  }
+  uint16_t low = Wire.read();
+  value = low | (Wire.read() << 8);
+  return true;
+}
+
+bool VemlSensor::read(RawReading &reading)
+{
+  return readRegister(VEML7700_REG_ALS, reading.als) && readRegister(VEML7700_REG_WHITE, reading.white);
+}
+
+float VemlSensor::readLux()
+{
+  return veml.readLux();
+}
@@ -0,0 +1,498 @@
+#include <Arduino.h>
+#include <AsyncTCP.h>
+#include <ESPAsyncWebServer.h>
+#include <atomic>
+#include <new>
+#include "alloc_guard.h"
+#include "buffer_pool.h"
+#include "history.h"
+#include "measurement.h"
+#include "metrics.h"
+#include "ota.h"
+#include "power.h"
+#include "sample_json.h"
+#include "spectral_correction.h"
+#include "td_curve.h"
+#include "telemetry.h"
+#include "web.h"
+#include "wifi_config.h"
+
+// Gzipped by scripts/gzip_html.py at build time
+extern const uint8_t index_html_gz_start[] asm("_binary_src_html_index_html_gz_start");
+extern const uint8_t index_html_gz_end[] asm("_binary_src_html_index_html_gz_end");
+
+AsyncWebServer server(80);
+// Server-Sent Events listeners, new values are pushed from loop()
+AsyncEventSource events("/events");
+
+// Time for the response to reach the client before rebooting
+#define RESTART_DELAY_MS 500
+// Set from the AsyncTCP task once restart_requested_ms is written, loop() reboots then
+std::atomic<bool> restart_pending(false);
+uint32_t restart_requested_ms;
+
+#define EVENT_KEEPALIVE_MS 15000
+#define EVENT_JSON_SIZE 160
+char last_event_json[SENSOR_CHANNELS][EVENT_JSON_SIZE];
+unsigned long last_event_ms[SENSOR_CHANNELS];
+
+// Response bodies are rendered into these instead of heap Strings and streams.
+// A buffer belongs to its request until the connection closes.
+#define SMALL_BUFFER_SIZE 320
+#define SMALL_BUFFERS 6
+#define LARGE_BUFFER_SIZE 8192
+#define LARGE_BUFFERS 2
+BufferPool<SMALL_BUFFER_SIZE, SMALL_BUFFERS> small_buffers;
+BufferPool<LARGE_BUFFER_SIZE, LARGE_BUFFERS> large_buffers;
+
+// Print into a fixed buffer, whatever doesn't fit is cut off
+class BufferPrint : public Print
+{
+public:
+  BufferPrint(uint8_t *buffer, size_t size) : length(0), buffer(buffer), size(size) {}
+
+  size_t write(uint8_t c) override
+  {
+    if (length == size)
+    {
+      return 0;
+    }
+    buffer[length++] = c;
+    return 1;
+  }
+
+  size_t write(const uint8_t *data, size_t len) override
+  {
+    size_t n = len < size - length ? len : size - length;
+    memcpy(buffer + length, data, n);
+    length += n;
+    return n;
+  }
+
+  size_t length;
+
+private:
+  uint8_t *buffer;
+  size_t size;
+};
+
+// Body kept in a pool buffer, the first word is its length
+struct PooledBody
+{
+  uint32_t length;
+  uint8_t data[1];
+};
+
+template <typename Pool>
+void sendPooled(AsyncWebServerRequest *request, Pool &pool, uint8_t *buffer, int code, const char *type)
+{
+  PooledBody *body = reinterpret_cast<PooledBody *>(buffer);
+  AsyncWebServerResponse *response = request->beginResponse(type, body->length,
+      [body](uint8_t *out, size_t maxLen, size_t index) -> size_t
+      {
+        size_t n = body->length - index < maxLen ? body->length - index : maxLen;
+        memcpy(out, body->data + index, n);
+        return n;
+      });
+  response->setCode(code);
+  response->addHeader("Cache-Control", "no-store");
+  request->onDisconnect([&pool, buffer]()
+  {
+    pool.release(buffer);
+  });
+  request->send(response);
+}
+
+// Strong ETag of the compressed page, computed once in setupWeb()
+char page_etag[12];
+
+void handleRoot(AsyncWebServerRequest *request)
+{
+  uint32_t start = micros();
+  if (request->hasHeader("If-None-Match") && request->header("If-None-Match") == page_etag)
+  {
+    AsyncWebServerResponse *response = request->beginResponse(304);
+    response->addHeader("ETag", page_etag);
+    request->send(response);
+    metrics.http_root.observe(micros() - start);
+    return;
+  }
+
+  // The page is static, the value comes from /api/td and /events
+  AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", index_html_gz_start, index_html_gz_end - index_html_gz_start);
+  response->addHeader("Content-Encoding", "gzip");
+  response->addHeader("ETag", page_etag);
+  // Always revalidate, an OTA update changes the page but a 304 costs next to nothing
+  response->addHeader("Cache-Control", "no-cache");
+  request->send(response);
+  metrics.http_root.observe(micros() - start);
+}
+
+int formatTdJson(uint8_t channel, char *buf, size_t size)
+{
+  uint8_t status = device_status.load();
+  Sample sample;
+  if (status != STATUS_READY)
+  {
+    return formatStatusJson(buf, size, channel, deviceStatusName(status));
+  }
+  if (!latestSample(channel, sample))
+  {
+    // Didn't answer at startup
+    return formatStatusJson(buf, size, channel, deviceStatusName(STATUS_NO_SENSOR));
+  }
+  return formatSampleJson(buf, size, sample);
+}
+
+// ?channel=N, 0 if not given. False if there is no such channel.
+bool channelParam(AsyncWebServerRequest *request, bool post, uint8_t &channel)
+{
+  channel = 0;
+  if (!request->hasParam("channel", post))
+  {
+    return true;
+  }
+  int value = request->getParam("channel", post)->value().toInt();
+  if (value < 0 || value >= SENSOR_CHANNELS)
+  {
+    return false;
+  }
+  channel = value;
+  return true;
+}
+
+void handleApiTd(AsyncWebServerRequest *request)
+{
+  uint8_t channel;
+  if (!channelParam(request, false, channel))
+  {
+    request->send(404, "text/plain", "no such channel");
+    return;
+  }
+  uint8_t *buffer = small_buffers.acquire();
+  if (buffer == NULL)
+  {
+    request->send(503);
+    return;
+  }
+  PooledBody *body = reinterpret_cast<PooledBody *>(buffer);
+  {
+    NoAllocScope no_alloc;
+    size_t room = SMALL_BUFFER_SIZE - offsetof(PooledBody, data);
+    int n = formatTdJson(channel, reinterpret_cast<char *>(body->data), room);
+    body->length = n < 0 ? 0 : ((size_t)n < room ? n : room - 1);
+  }
+  sendPooled(request, small_buffers, buffer, 200, "application/json");
+}
+
+void handleCalibrate(AsyncWebServerRequest *request)
+{
+  if (device_status.load() == STATUS_NO_SENSOR)
+  {
+    request->send(503, "text/plain", "sensor not found");
+    return;
+  }
+  // The sensor task owns the baseline, it picks this up before its next sample
+  calibrate_requested = true;
+  request->send(202, "text/plain", "calibrating");
+}
+
+typedef HistoryExport<HISTORY_SIZE> Export;
+
+void sendHistory(AsyncWebServerRequest *request, Export::Format format, uint32_t first_seq, uint32_t end_seq)
+{
+  static_assert(sizeof(Export) <= SMALL_BUFFER_SIZE, "history export doesn't fit a small buffer");
+
+  uint8_t *buffer = small_buffers.acquire();
+  if (buffer == NULL)
+  {
+    request->send(503);
+    return;
+  }
+  // The export only holds one row at a time, the document is never built as a whole.
+  // It lives in the pool buffer, so the callback only captures a pointer.
+  Export *exporter = new (buffer) Export(history, format, first_seq, end_seq);
+  AsyncWebServerResponse *response = request->beginChunkedResponse(
+      format == Export::CSV ? "text/csv" : "application/json",
+      [exporter](uint8_t *out, size_t maxLen, size_t index) -> size_t
+      {
+        NoAllocScope no_alloc;
+        return exporter->fill(out, maxLen);
+      });
+  response->addHeader("Cache-Control", "no-store");
+  request->onDisconnect([buffer]()
+  {
+    small_buffers.release(buffer);
+  });
+  request->send(response);
+}
+
+Export::Format formatParam(AsyncWebServerRequest *request, Export::Format fallback)
+{
+  if (!request->hasParam("format"))
+  {
+    return fallback;
+  }
+  const String &format = request->getParam("format")->value();
+  return format == "csv" ? Export::CSV : format == "hueforge" ? Export::HUEFORGE : Export::JSON;
+}
+
+void handleHistory(AsyncWebServerRequest *request)
+{
+  sendHistory(request, formatParam(request, Export::JSON), 0, UINT32_MAX);
+}
+
+void handleStartSession(AsyncWebServerRequest *request)
+{
+  const char *labels = request->hasParam("labels", true) ? request->getParam("labels", true)->value().c_str() : "";
+  const char *prefix = request->hasParam("prefix", true) ? request->getParam("prefix", true)->value().c_str() : "Spool";
+  if (!startSession(labels, prefix))
+  {
+    request->send(400, "text/plain", "too many labels");
+    return;
+  }
+  request->send(204);
+}
+
+void handleEndSession(AsyncWebServerRequest *request)
+{
+  endSession();
+  request->send(204);
+}
+
+void handleSession(AsyncWebServerRequest *request)
+{
+  uint8_t *buffer = small_buffers.acquire();
+  if (buffer == NULL)
+  {
+    request->send(503);
+    return;
+  }
+  SessionInfo info = sessionInfo();
+  PooledBody *body = reinterpret_cast<PooledBody *>(buffer);
+  size_t room = SMALL_BUFFER_SIZE - offsetof(PooledBody, data);
+  int n = snprintf(reinterpret_cast<char *>(body->data), room, "{\"active\":%s,\"first_seq\":%u,\"measured\":%u,\"queued\":%u}",
+                   info.active ? "true" : "false", (unsigned)info.first_seq, (unsigned)(info.end_seq - info.first_seq), (unsigned)info.queued);
+  body->length = n < 0 ? 0 : ((size_t)n < room ? n : room - 1);
+  sendPooled(request, small_buffers, buffer, 200, "application/json");
+}
+
+void handleSessionExport(AsyncWebServerRequest *request)
+{
+  SessionInfo info = sessionInfo();
+  sendHistory(request, formatParam(request, Export::HUEFORGE), info.first_seq, info.end_seq);
+}
+
+void handleLabel(AsyncWebServerRequest *request)
+{
+  if (!request->hasParam("label", true))
+  {
+    request->send(400, "text/plain", "missing label");
+    return;
+  }
+  uint8_t channel;
+  if (!channelParam(request, true, channel))
+  {
+    request->send(404, "text/plain", "no such channel");
+    return;
+  }
+  setPendingLabel(channel, request->getParam("label", true)->value().c_str());
+  request->send(204);
+}
+
+void handleSetCurve(AsyncWebServerRequest *request)
+{
+  if (!request->hasParam("points", true))
+  {
+    request->send(400, "text/plain", "missing points");
+    return;
+  }
+  if (td_curve.busy())
+  {
+    // The sensor task hasn't moved past the last change yet, that takes one sample
+    request->send(503, "text/plain", "curve change in progress, try again");
+    return;
+  }
+  if (!setUserCurve(request->getParam("points", true)->value().c_str()))
+  {
+    request->send(400, "text/plain", "invalid curve");
+    return;
+  }
+  request->send(204);
+}
+
+void handleClearCurve(AsyncWebServerRequest *request)
+{
+  clearUserCurve();
+  request->send(204);
+}
+
+void handleTelemetry(AsyncWebServerRequest *request)
+{
+  if (!request->hasParam("enabled", true))
+  {
+    request->send(400, "text/plain", "missing enabled");
+    return;
+  }
+  const String &enabled = request->getParam("enabled", true)->value();
+  if (enabled != "0" && enabled != "1")
+  {
+    request->send(400, "text/plain", "enabled must be 0 or 1");
+    return;
+  }
+  setTelemetryEnabled(enabled == "1");
+  request->send(204);
+}
+
+void handleSetSpectral(AsyncWebServerRequest *request)
+{
+  if (!request->hasParam("weight", true))
+  {
+    request->send(400, "text/plain", "missing weight");
+    return;
+  }
+  if (!setSpectralWeight(request->getParam("weight", true)->value().c_str()))
+  {
+    request->send(400, "text/plain", "invalid weight");
+    return;
+  }
+  request->send(204);
+}
+
+void handleClearSpectral(AsyncWebServerRequest *request)
+{
+  clearSpectralWeight();
+  request->send(204);
+}
+
+void handleMetrics(AsyncWebServerRequest *request)
+{
+  uint8_t *buffer = large_buffers.acquire();
+  if (buffer == NULL)
+  {
+    request->send(503);
+    return;
+  }
+  PooledBody *body = reinterpret_cast<PooledBody *>(buffer);
+  {
+    NoAllocScope no_alloc;
+    BufferPrint out(body->data, LARGE_BUFFER_SIZE - offsetof(PooledBody, data));
+    writeMetrics(out);
+    body->length = out.length;
+  }
+  sendPooled(request, large_buffers, buffer, 200, "text/plain; version=0.0.4");
+}
+
+void handleNotFound(AsyncWebServerRequest *request)
+{
+  uint32_t start = micros();
+  if (stationMode())
+  {
+    // Only the captive portal needs every unknown URL to land on the page
+    request->send(404);
+    metrics.http_not_found.observe(micros() - start);
+    return;
+  }
+  request->redirect("/");
+  metrics.http_not_found.observe(micros() - start);
+}
+
+void publishEvents()
+{
+  for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+  {
+    char json[EVENT_JSON_SIZE];
+    formatTdJson(ch, json, sizeof(json));
+    bool changed = strcmp(json, last_event_json[ch]) != 0;
+    // Resending the value now and then lets dead connections get noticed
+    bool keepalive = millis() - last_event_ms[ch] > EVENT_KEEPALIVE_MS;
+    if (!changed && !keepalive)
+    {
+      continue;
+    }
+    if (events.count() > 0)
+    {
+      events.send(json);
+    }
+    strcpy(last_event_json[ch], json);
+    last_event_ms[ch] = millis();
+  }
+}
+
+uint32_t fnv1a(const uint8_t *data, size_t len)
+{
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < len; i++)
+  {
+    hash = (hash ^ data[i]) * 16777619u;
+  }
+  return hash;
+}
+
+void setupWeb()
+{
+  snprintf(page_etag, sizeof(page_etag), "\"%08x\"", (unsigned)fnv1a(index_html_gz_start, index_html_gz_end - index_html_gz_start));
+
+  setupWifi();
+
+  // Runs ahead of every route, so the CPU is back at full speed before the handler does
+  server.addMiddleware([](AsyncWebServerRequest *, ArMiddlewareNext next)
+  {
+    wakeUp();
+    next();
+  });
+  // serve a simple root page
+  server.on("/", HTTP_GET, handleRoot);
+  server.on("/api/td", HTTP_GET, handleApiTd);
+  server.on("/api/calibrate", HTTP_POST, handleCalibrate);
+  server.on("/api/history", HTTP_GET, handleHistory);
+  server.on("/api/label", HTTP_POST, handleLabel);
+  // Before /api/session, which would match it as a sub path
+  server.on("/api/session/export", HTTP_GET, handleSessionExport);
+  server.on("/api/session", HTTP_GET, handleSession);
+  server.on("/api/session", HTTP_POST, handleStartSession);
+  server.on("/api/session", HTTP_DELETE, handleEndSession);
+  server.on("/api/curve", HTTP_POST, handleSetCurve);
+  server.on("/api/curve", HTTP_DELETE, handleClearCurve);
+  server.on("/api/telemetry", HTTP_POST, handleTelemetry);
+  server.on("/api/spectral", HTTP_POST, handleSetSpectral);
+  server.on("/api/spectral", HTTP_DELETE, handleClearSpectral);
+  server.on("/metrics", HTTP_GET, handleMetrics);
+  setupOta(server);
+  setupWifiRoutes(server);
+
+  events.onConnect([](AsyncEventSourceClient *client)
+  {
+    for (uint8_t ch = 0; ch < SENSOR_CHANNELS; ch++)
+    {
+      char json[EVENT_JSON_SIZE];
+      formatTdJson(ch, json, sizeof(json));
+      client->send(json);
+    }
+  });
+  server.addHandler(&events);
+
+  // serve portal page
+  server.onNotFound(handleNotFound);
+  server.begin();
+}
+
+void loopWeb()
+{
+  publishEvents();
+  if (restart_pending.load(std::memory_order_acquire) && millis() - restart_requested_ms >= RESTART_DELAY_MS)
+  {
+    ESP.restart();
+  }
+}
+
+void restartSoon()
+{
+  restart_requested_ms = millis();
+  restart_pending.store(true, std::memory_order_release);
+}
+
+size_t eventSubscribers()
+{
+  return events.count();
+}
@@ -0,0 +1,129 @@
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <ESPmDNS.h>
+#include <Preferences.h>
+#include <WiFi.h>
+#include "captive_dns.h"
+#include "ota.h"
+#include "web.h"
+#include "wifi_config.h"
+
+#define WIFI_HOSTNAME "td-free"
+// Give up on the stored network after this long and open the soft-AP
+#define WIFI_CONNECT_TIMEOUT_MS 15000
+#define WIFI_SSID_SIZE 33
+#define WIFI_PASSWORD_SIZE 65
+
+IPAddress apIP(192, 168, 0, 1);
+IPAddress netMsk(255, 255, 255, 0);
+CaptiveDns dnsServer;
+bool station_mode;
+
+bool joinStoredNetwork()
+{
+  char ssid[WIFI_SSID_SIZE] = "";
+  char password[WIFI_PASSWORD_SIZE] = "";
+  Preferences wifi_prefs;
+  wifi_prefs.begin("td-wifi", true);
+  wifi_prefs.getString("ssid", ssid, sizeof(ssid));
+  wifi_prefs.getString("password", password, sizeof(password));
+  wifi_prefs.end();
+  if (ssid[0] == 0)
+  {
+    return false;
+  }
+
+  // Arduino-ESP32 2.x only applies the hostname when the station interface comes up
+  WiFi.setHostname(WIFI_HOSTNAME);
+  WiFi.mode(WIFI_STA);
+  WiFi.begin(ssid, password);
+  uint32_t start = millis();
+  while (WiFi.status() != WL_CONNECTED)
+  {
+    if (millis() - start > WIFI_CONNECT_TIMEOUT_MS)
+    {
+      Serial.println("WiFi not reachable, opening the hotspot");
+      WiFi.disconnect(true);
+      return false;
+    }
+    delay(100);
+  }
+  return true;
+}
+
+void setupWifi()
+{
+  station_mode = joinStoredNetwork();
+  if (station_mode)
+  {
+    // Nothing to intercept on a real network, everyone finds it by name
+    MDNS.begin(WIFI_HOSTNAME);
+    MDNS.addService("http", "tcp", 80);
+    return;
+  }
+
+  WiFi.mode(WIFI_AP);
+  WiFi.softAPConfig(apIP, apIP, netMsk);
+  WiFi.softAP("Td-Free");
+  dnsServer.begin(apIP);
+}
+
+bool stationMode()
+{
+  return station_mode;
+}
+
+uint32_t dnsQueries()
+{
+  return dnsServer.answered();
+}
+
+void handleSetWifi(AsyncWebServerRequest *request)
+{
+  if (!request->authenticate(OTA_USERNAME, adminPassword()))
+  {
+    request->requestAuthentication();
+    return;
+  }
+  if (!request->hasParam("ssid", true))
+  {
+    request->send(400, "text/plain", "missing ssid");
+    return;
+  }
+  const String &ssid = request->getParam("ssid", true)->value();
+  const char *password = request->hasParam("password", true) ? request->getParam("password", true)->value().c_str() : "";
+  if (ssid.length() == 0 || ssid.length() >= WIFI_SSID_SIZE || strlen(password) >= WIFI_PASSWORD_SIZE)
+  {
+    request->send(400, "text/plain", "invalid ssid or password");
+    return;
+  }
+  Preferences wifi_prefs;
+  wifi_prefs.begin("td-wifi");
+  wifi_prefs.putString("ssid", ssid.c_str());
+  wifi_prefs.putString("password", password);
+  wifi_prefs.end();
+  request->send(200, "text/plain", "stored, rebooting");
+  restartSoon();
+}
+
+void handleClearWifi(AsyncWebServerRequest *request)
+{
+  if (!request->authenticate(OTA_USERNAME, adminPassword()))
+  {
+    request->requestAuthentication();
+    return;
+  }
+  Preferences wifi_prefs;
+  wifi_prefs.begin("td-wifi");
+  wifi_prefs.remove("ssid");
+  wifi_prefs.remove("password");
+  wifi_prefs.end();
+  request->send(200, "text/plain", "forgotten, rebooting");
+  restartSoon();
+}
+
+void setupWifiRoutes(AsyncWebServer &server)
+{
+  server.on("/api/wifi", HTTP_POST, handleSetWifi);
+  server.on("/api/wifi", HTTP_DELETE, handleClearWifi);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+// Just enough of the Arduino core for the firmware headers to compile in
+// env:native. Time comes from the host clock, nothing talks to hardware.
+#include <chrono>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef void *TaskHandle_t;
+
+inline unsigned long micros()
+{
+  using namespace std::chrono;
+  return (unsigned long)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+inline unsigned long millis()
+{
+  return micros() / 1000;
+}
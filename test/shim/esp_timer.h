@@ -0,0 +1,4 @@
+#pragma once
+
+// Types only, so sample_clock.h compiles in env:native. Nothing links against these.
+typedef struct esp_timer *esp_timer_handle_t;
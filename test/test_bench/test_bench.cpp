@@ -0,0 +1,304 @@
+// Host benchmarks of the per-sample and per-request hot paths, `pio test -e native -v`
+// prints a line per benchmark. Every one also has to stay off the heap.
+#include <Arduino.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unity.h>
+// board.h and sample_clock.h aren't benchmarked, they are only here to keep them host-buildable
+#include "board.h"
+#include "filament_detector.h"
+#include "history.h"
+#include "metrics.h"
+#include "sample_clock.h"
+#include "sample_json.h"
+#include "spectral_correction.h"
+#include "td_curve.h"
+#include "td_filter.h"
+#include "transmission.h"
+
+// src/ isn't built for native, these live in its translation units on the device
+constexpr float TdCurve::DEFAULT_CURVE[TD_CURVE_POINTS];
+const uint32_t Histogram::BOUNDS_US[Histogram::BOUND_COUNT] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000,
+};
+
+// Counts every heap allocation of the process. glibc lets malloc and friends be
+// replaced by forwarding to its own implementation, elsewhere only new is seen.
+static unsigned long allocations;
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+extern "C" void *malloc(size_t size)
+{
+  allocations++;
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+  allocations++;
+  return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+  allocations++;
+  return __libc_realloc(ptr, size);
+}
+#else
+void *operator new(size_t size)
+{
+  allocations++;
+  void *p = malloc(size);
+  if (p == NULL)
+  {
+    abort();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
+#endif
+
+// Keeps results alive so the optimizer can't drop the work
+static volatile float sink;
+
+struct Result
+{
+  double ns_per_op;
+  double allocs_per_op;
+};
+
+template <typename F>
+Result bench(const char *name, unsigned long iterations, F op)
+{
+  op(0); // warm-up, first-use allocations of the C library don't count
+  unsigned long before = allocations;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < iterations; i++)
+  {
+    op(i);
+  }
+  std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+  Result result;
+  result.ns_per_op = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+  result.allocs_per_op = (double)(allocations - before) / iterations;
+  printf("%-28s %10.1f ns/op %8.2f allocs/op\n", name, result.ns_per_op, result.allocs_per_op);
+  return result;
+}
+
+// A transmission trace with filament going in, settling and coming out again
+static float trace(unsigned long i)
+{
+  unsigned long t = i % 200;
+  if (t < 40 || t >= 160)
+  {
+    return 100.0f + (t % 3) * 0.1f;
+  }
+  return 35.0f + (t % 5) * 0.05f;
+}
+
+static FilamentDetector::Config detector_config = {90, 95, 2, 2, 100, 1, 0.2f, 4};
+
+static Sample makeSample(unsigned long i)
+{
+  Sample sample = {};
+  sample.seq = i;
+  sample.timestamp_ms = i * 100;
+  sample.lux = 1234.5f;
+  sample.baseline = 3456.7f;
+  sample.transmission = trace(i);
+  sample.filtered = sample.transmission;
+  sample.td = 4.2f;
+  sample.stable = true;
+  sample.state = FilamentDetector::LATCHED;
+  sample.latched = 35.1f;
+  sample.confidence = 0.12f;
+  return sample;
+}
+
+void test_td_math()
+{
+  TdCurve curve;
+  Result r = bench("transmission_and_td", 1000000, [&](unsigned long i)
+  {
+    sink = curve.map(transmissionPercent(1000.0f + i % 3000, 3500.0f));
+  });
+  TEST_ASSERT_EQUAL_FLOAT(0, r.allocs_per_op);
+}
+
+void test_curve_load()
+{
+  TdCurve curve;
+  const float transmission[] = {5, 20, 60, 90};
+  const float td[] = {1.2f, 2.8f, 9.5f, 30};
+  Result r = bench("curve_load", 10000, [&](unsigned long)
+  {
+    bool loaded = curve.load(transmission, td, 4);
+    sink = curve.map(50) + loaded;
+    curve.acknowledge();
+  });
+  TEST_ASSERT_EQUAL_FLOAT(0, r.allocs_per_op);
+  // A second load before the mapping side acknowledged the first must not overwrite what it may be reading
+  TEST_ASSERT_TRUE(curve.load(transmission, td, 4));
+  TEST_ASSERT_TRUE(curve.busy());
+  TEST_ASSERT_TRUE(!curve.load(transmission, td, 4));
+  curve.acknowledge();
+  TEST_ASSERT_TRUE(curve.load(transmission, td, 4));
+}
+
+void test_spectral_correct()
+{
+  int32_t weight_q16 = spectralWeightQ16(0.35f);
+  Result r = bench("spectral_correct", 1000000, [&](unsigned long i)
+  {
+    sink = spectralCorrect(20000 + i % 3000, 26000, weight_q16);
+  });
+  TEST_ASSERT_EQUAL_FLOAT(0, r.allocs_per_op);
+  TEST_ASSERT_TRUE(spectralCorrect(12345, 23456, 0) == 12345);
+  TEST_ASSERT_TRUE(spectralCorrect(20000, 10000, spectralWeightQ16(0.5f)) == 25000);
+  TEST_ASSERT_TRUE(spectralCorrect(1000, 60000, spectralWeightQ16(1)) == 0);
+  TEST_ASSERT_TRUE(spectralCorrect(60000, 1000, spectralWeightQ16(1)) == 65535);
+}
+
+void test_filter_update()
+{
+  TdFilter<5, 4> filter(0.3f);
+  Result r = bench("filter_update", 1000000, [&](unsigned long i)
+  {
+    sink = filter.update(trace(i));
+  });
+  TEST_ASSERT_EQUAL_FLOAT(0, r.allocs_per_op);
+}
+
+void test_detector_update()
+{
+  TdFilter<5, 4> filter(0.3f);
+  FilamentDetector detector(detector_config);
+  Result r = bench("detector_update", 1000000, [&](unsigned long i)
+  {
+    sink = detector.update(trace(i), filter);
+  });
+  TEST_ASSERT_EQUAL_FLOAT(0, r.allocs_per_op);
+}
+
+void test_sample_json()
+{
+  char json[160];
+  Result r = bench("sample_json", 200000, [&](unsigned long i)
+  {
+    Sample sample = makeSample(i);
+    sink = formatSampleJson(json, sizeof(json), sample);
+  });
+  TEST_ASSERT_EQUAL_FLOAT(0, r.allocs_per_op);
+}
+
+void test_histogram_observe()
+{
+  static Histogram histogram;
+  Result r = bench("histogram_observe", 1000000, [&](unsigned long i)
+  {
+    histogram.observe(i % 300000);
+  });
+  TEST_ASSERT_EQUAL_FLOAT(0, r.allocs_per_op);
+}
+
+// One full document of a full history, rendered in chunks of a TCP segment
+template <size_t N>
+void exportHistory(const char *name, const SampleRing<Measurement, N> &ring, typename HistoryExport<N>::Format format)
+{
+  uint8_t chunk[1460];
+  Result r = bench(name, 2000, [&](unsigned long)
+  {
+    HistoryExport<N> exporter(ring, format);
+    size_t total = 0;
+    size_t n;
+    while ((n = exporter.fill(chunk, sizeof(chunk))) > 0)
+    {
+      total += n;
+    }
+    sink = total;
+  });
+  TEST_ASSERT_EQUAL_FLOAT(0, r.allocs_per_op);
+}
+
+void test_history_export()
+{
+  static SampleRing<Measurement, HISTORY_SIZE> ring;
+  for (uint32_t i = 0; i < HISTORY_SIZE; i++)
+  {
+    Measurement m = {};
+    m.seq = i;
+    m.timestamp_ms = i * 5000;
+    m.transmission = 35.12f;
+    m.ci = 0.15f;
+    m.td = 4.21f;
+    m.lux = 1234.5f;
+    m.baseline = 3456.7f;
+    snprintf(m.label, sizeof(m.label), "Spool %u", (unsigned)i);
+    ring.push(m);
+  }
+  exportHistory("history_export_json", ring, HistoryExport<HISTORY_SIZE>::JSON);
+  exportHistory("history_export_csv", ring, HistoryExport<HISTORY_SIZE>::CSV);
+  exportHistory("history_export_hueforge", ring, HistoryExport<HISTORY_SIZE>::HUEFORGE);
+}
+
+// Widest values everywhere and a label that doubles in length when escaped
+void test_history_worst_case_row()
+{
+  static SampleRing<Measurement, 2> ring;
+  for (int i = 0; i < 2; i++)
+  {
+    Measurement m = {};
+    m.seq = 4294967295u;
+    m.timestamp_ms = 4294967295u;
+    m.channel = 255;
+    m.transmission = -1e30f;
+    m.ci = 12345678.9f;
+    m.td = -9999999.5f;
+    m.lux = 1e30f;
+    m.baseline = NAN;
+    memset(m.label, i == 0 ? '"' : '\\', LABEL_SIZE - 1);
+    m.label[LABEL_SIZE - 1] = 0;
+    ring.push(m);
+  }
+  const HistoryExport<2>::Format formats[] = {HistoryExport<2>::JSON, HistoryExport<2>::CSV, HistoryExport<2>::HUEFORGE};
+  const char *endings[] = {"\"}]\n", "\"\n", "\"PLA\"}]}\n"};
+  for (int f = 0; f < 3; f++)
+  {
+    HistoryExport<2> exporter(ring, formats[f]);
+    char document[1024];
+    size_t len = exporter.fill(reinterpret_cast<uint8_t *>(document), sizeof(document) - 1);
+    document[len] = 0;
+    // A cut row would lose its end, or the row would be missing and leave no label at all
+    TEST_ASSERT_TRUE(len > 2 * LABEL_SIZE);
+    TEST_ASSERT_TRUE(strcmp(document + len - strlen(endings[f]), endings[f]) == 0);
+    TEST_ASSERT_TRUE(strstr(document, "nan") == NULL && strstr(document, "inf") == NULL);
+  }
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_td_math);
+  RUN_TEST(test_curve_load);
+  RUN_TEST(test_spectral_correct);
+  RUN_TEST(test_filter_update);
+  RUN_TEST(test_detector_update);
+  RUN_TEST(test_sample_json);
+  RUN_TEST(test_histogram_observe);
+  RUN_TEST(test_history_export);
+  RUN_TEST(test_history_worst_case_row);
+  return UNITY_END();
+}